@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ast.hpp"
+#include "table.hpp"
+#include "visitor.hpp"
+
+#include "llvm/ADT/SmallVector.h"
+
+#include <unordered_map>
+
+// An array passed on to another function: what the callee does with its argument
+// `pos` is done to `array`.
+struct Forward {
+    Symbol *callee;
+    unsigned pos;
+    Symbol *array;
+};
+
+// What a function does besides computing its result. The walk fills in what its own
+// body does, resolve() adds what its callees do.
+struct Effects {
+    TrenStmt *tren = nullptr;
+    bool resolved = false;
+
+    bool output = false; // print or echo
+    bool runtime = false; // heap arrays or fightclub, calls into the runtime
+    bool loops = false; // alive loops, which may never end
+    bool cache = false; // touches the cache of a memoized function
+    bool reads_global = false, writes_global = false; // mutable globals
+    bool reads_const = false; // const globals, fixed once they are initialized
+    unsigned reads_args = 0, writes_args = 0; // arrays it got as arguments, one bit each
+
+    int self_calls = 0; // call sites of the function inside its own body
+    llvm::SmallVector<Symbol *, 4> callees; // other user functions it calls
+    llvm::SmallVector<Forward, 4> forwards;
+};
+
+// Walks the whole program after folding and summarizes every function. Codegen then
+// memoizes pure functions over ints that call themselves more than once, so subproblems
+// overlap, and that cannot run on several threads at a time, and turns the summaries of
+// all functions into LLVM attributes (TrenStmt::facts).
+struct EffectVisitor: public ASTVisitor {
+    std::unordered_map<Symbol *, Effects> effects; // stays put while nested functions are added
+    vector<Symbol *> order; // functions in the order their bodies end, callees first
+    vector<Symbol *> parallel; // functions called from fightclub bodies
+
+    Effects *curr = nullptr; // function being walked, null at the top level
+    bool in_fightclub = false;
+
+    int argument(Symbol *) const;
+    Symbol *arrayRoot(Expr *);
+    void read(Symbol *);
+    void write(Symbol *);
+    void forward(Effects&, const Forward&);
+    void resolve();
+
+    Value *visit(WarStmt&);
+    Function *visit(TrenStmt&);
+    Value *visit(RetStmt&);
+    Value *visit(IfStmt&);
+    Value *visit(AliveStmt&);
+    Value *visit(ForStmt&);
+    Value *visit(FightStmt&);
+    Value *visit(HighExpr&);
+    Value *visit(ParenStmts&);
+
+    Value *visit(AssignExpr&);
+    Value *visit(BoolExpr&);
+    Value *visit(AddExpr&);
+    Value *visit(TermExpr&);
+    Value *visit(IDExpr&);
+    Value *visit(CallExpr&);
+    Value *visit(IntExpr&);
+    Value *visit(ArrayExpr&);
+    Value *visit(ParenExpr&);
+    Value *visit(IndexExpr&);
+
+    Value *visit(Input&);
+};
+
+
+class Analyzer: public CompilerPass {
+public:
+    void accept(shared_ptr<IVisitor> vis) { vis->visit(*this); }
+
+    Analyzer() {}
+};
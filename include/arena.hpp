@@ -0,0 +1,34 @@
+#pragma once
+
+#include "llvm/Support/Allocator.h"
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Per-compilation bump allocator for AST nodes, types and symbols.
+// Everything made here lives until the arena dies and is released in one shot,
+// so nodes refer to each other with plain pointers.
+class Arena {
+    llvm::BumpPtrAllocator alloc;
+    std::vector<std::pair<void *, void (*)(void *)>> dtors;
+public:
+    template<typename T, typename... Args>
+    T *make(Args&&... args) {
+        T *obj = new (alloc.Allocate<T>()) T(std::forward<Args>(args)...);
+
+        if constexpr(!std::is_trivially_destructible_v<T>)
+            dtors.push_back({obj, [](void *p) { static_cast<T *>(p)->~T(); }});
+
+        return obj;
+    }
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() {
+        for(auto it = dtors.rbegin(); it != dtors.rend(); ++it)
+            it->second(it->first);
+    }
+};
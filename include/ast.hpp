@@ -12,6 +12,7 @@
 using std::shared_ptr, std::unique_ptr, std::make_unique, std::make_shared, std::string, std::vector, std::pair;
 
 // Abstract Classes
+// Nodes are allocated in the compilation Arena and never deleted individually
 
 struct Node {
     virtual Value *accept(ASTVisitor&) = 0;
@@ -24,217 +25,283 @@ struct Stmt: public Node {
 };
 
 struct Expr: public Node {
-    virtual shared_ptr<ValueType> getType() const = 0;
+    virtual ValueType *getType() const = 0;
     virtual ~Expr() = default;
 };
 
 // Expressions
 
 struct AssignExpr: public Expr {
-    unique_ptr<Expr> LHS, RHS;
-    shared_ptr<ValueType> type;
+    Expr *LHS, *RHS;
+    ValueType *type;
 
-    shared_ptr<ValueType> getType() const { return type; }
+    ValueType *getType() const { return type; }
     
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
 
-    AssignExpr(unique_ptr<Expr> lhs, unique_ptr<Expr> rhs, shared_ptr<ValueType> type)
-        : LHS(std::move(lhs)), RHS(std::move(rhs)), type(type) {}
+    AssignExpr(Expr *lhs, Expr *rhs, ValueType *type)
+        : LHS(lhs), RHS(rhs), type(type) {}
 };
 
 
 struct BoolExpr: public Expr {    
-    unique_ptr<Expr> LHS, RHS;
+    Expr *LHS, *RHS;
     TOKEN::lexeme OP;
-    shared_ptr<ValueType> type;
+    ValueType *type;
 
-    shared_ptr<ValueType> getType() const { return type; }
+    ValueType *getType() const { return type; }
     
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
     
-    BoolExpr(TOKEN::lexeme OP, unique_ptr<Expr> lhs, unique_ptr<Expr> rhs, shared_ptr<ValueType> type)
-        : OP(OP), LHS(std::move(lhs)), RHS(std::move(rhs)), type(type) {}
+    BoolExpr(TOKEN::lexeme OP, Expr *lhs, Expr *rhs, ValueType *type)
+        : OP(OP), LHS(lhs), RHS(rhs), type(type) {}
 };
 
 
 struct AddExpr: public Expr {
-    unique_ptr<Expr> LHS, RHS;
+    Expr *LHS, *RHS;
     TOKEN::lexeme OP;
-    shared_ptr<ValueType> type;
+    ValueType *type;
 
-    shared_ptr<ValueType> getType() const { return type; }
+    ValueType *getType() const { return type; }
 
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
     
-    AddExpr(TOKEN::lexeme OP, unique_ptr<Expr> lhs, unique_ptr<Expr> rhs, shared_ptr<ValueType> type)
-        : OP(OP), LHS(std::move(lhs)), RHS(std::move(rhs)), type(type) {}
+    AddExpr(TOKEN::lexeme OP, Expr *lhs, Expr *rhs, ValueType *type)
+        : OP(OP), LHS(lhs), RHS(rhs), type(type) {}
 };
 
 struct TermExpr: public Expr {
-    unique_ptr<Expr> LHS, RHS;
+    Expr *LHS, *RHS;
     TOKEN::lexeme OP;
-    shared_ptr<ValueType> type;
+    ValueType *type;
 
-    shared_ptr<ValueType> getType() const { return type; }
+    ValueType *getType() const { return type; }
     
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
     
-    TermExpr(TOKEN::lexeme OP, unique_ptr<Expr> lhs, unique_ptr<Expr> rhs, shared_ptr<ValueType> type)
-        : OP(OP), LHS(std::move(lhs)), RHS(std::move(rhs)), type(type) {}
+    TermExpr(TOKEN::lexeme OP, Expr *lhs, Expr *rhs, ValueType *type)
+        : OP(OP), LHS(lhs), RHS(rhs), type(type) {}
 };
 
 
 struct IDExpr: public Expr {
     string name;
-    shared_ptr<ValueType> type;
+    Symbol *sym;
+    ValueType *type;
 
-    shared_ptr<ValueType> getType() const { return type; }
+    ValueType *getType() const { return type; }
 
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
     
-    IDExpr(const string& name, shared_ptr<ValueType> type)
-        : name(name), type(type) {}
+    IDExpr(const string& name, Symbol *sym, ValueType *type)
+        : name(name), sym(sym), type(type) {}
 };
 
 
 struct CallExpr: public Expr {
-    vector<unique_ptr<Expr>> args;
-    shared_ptr<ValueType> type;
+    vector<Expr *> args;
+    ValueType *type;
     string name;
+    Symbol *sym;
 
-    shared_ptr<ValueType> getType() const { return type; }
+    ValueType *getType() const { return type; }
 
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
 
-    CallExpr(const string& name, vector<unique_ptr<Expr>> args, shared_ptr<ValueType> type)
-        : name(name), args(std::move(args)), type(type) {}
+    CallExpr(const string& name, Symbol *sym, vector<Expr *> args, ValueType *type)
+        : name(name), sym(sym), args(std::move(args)), type(type) {}
 };
 
 struct IntExpr: public Expr {
-    shared_ptr<ValueType> type;
+    ValueType *type;
     ll value;
 
-    shared_ptr<ValueType> getType() const { return type; }
+    ValueType *getType() const { return type; }
     
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
 
-    IntExpr(ll val) : value(val), type(make_shared<IntType>()) {}
+    IntExpr(ll val, ValueType *type) : value(val), type(type) {}
 };
 
 struct ArrayExpr: public Expr {
-    vector<unique_ptr<Expr>> elements;
-    shared_ptr<ValueType> type;
+    vector<Expr *> elements;
+    ValueType *type;
 
-    shared_ptr<ValueType> getType() const { return type; }
+    ValueType *getType() const { return type; }
     
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
 
-    ArrayExpr(vector<unique_ptr<Expr>> elems, shared_ptr<ValueType> type)
+    ArrayExpr(vector<Expr *> elems, ValueType *type)
         : elements(std::move(elems)), type(type) {}
 };
 
 struct ParenExpr: public Expr {
-    unique_ptr<Expr> expr;
+    Expr *expr;
 
-    shared_ptr<ValueType> getType() const { return expr->getType(); }
+    ValueType *getType() const { return expr->getType(); }
     
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
 
-    ParenExpr(unique_ptr<Expr> expr)
-        : expr(std::move(expr)) {}
+    ParenExpr(Expr *expr)
+        : expr(expr) {}
 };
 
 struct IndexExpr: public Expr {
-    vector<unique_ptr<Expr>> Idxs;
-    shared_ptr<ValueType> type;
+    vector<Expr *> Idxs;
+    ValueType *type;
     string name;
+    Symbol *sym;
 
-    shared_ptr<ValueType> getType() const { return type; }
+    ValueType *getType() const { return type; }
     
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
 
-    IndexExpr(const string& name, vector<unique_ptr<Expr>> Idxs, shared_ptr<ValueType> type)
-        : name(name), Idxs(std::move(Idxs)), type(type) {}
+    IndexExpr(const string& name, Symbol *sym, vector<Expr *> Idxs, ValueType *type)
+        : name(name), sym(sym), Idxs(std::move(Idxs)), type(type) {}
 };
 
 
 // Statements
 
+// Optional hints written after '|' in a condition, e.g. alive by[i <= n | unroll 4, vectorize 8]
+struct Hints {
+    int unroll = 0, vectorize = 0; // loops: llvm.loop unroll count and vectorize width
+    int likely = 0;                // if: 1 likely, -1 unlikely
+};
+
 struct WarStmt: public Stmt {
-    shared_ptr<ValueType> type;
-    unique_ptr<Expr> value;
+    ValueType *type;
+    Expr *value; // null for heap arrays, which start zeroed
+    Expr *size; // element count of a heap array, null otherwise
     string name;
+    Symbol *sym;
 
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
     
-    WarStmt(const string& name, unique_ptr<Expr> value, shared_ptr<ValueType> type)
-        : name(name), value(std::move(value)), type(type) {}
+    WarStmt(const string& name, Symbol *sym, Expr *value, ValueType *type, Expr *size = nullptr)
+        : name(name), sym(sym), value(value), type(type), size(size) {}
+};
+
+// What the Analyzer proved about a function, codegen turns it into LLVM attributes.
+// The defaults claim nothing.
+struct FuncFacts {
+    bool argmem = true, globals = true, inaccessible = true; // memory it may touch
+    bool writes = true; // false when it only reads memory
+    bool willreturn = false, norecurse = false;
+    unsigned readonly = 0, noalias = 0; // array arguments, one bit each
 };
 
 struct TrenStmt: public Stmt {
-    vector<pair<string, shared_ptr<ValueType>>> args;
-    shared_ptr<ValueType> retType;
-    unique_ptr<Stmt> func_body;
+    vector<pair<string, ValueType *>> args;
+    ValueType *retType;
+    Stmt *func_body;
     string name;
+    Symbol *sym;
+    int nslots; // locals including arguments
+    bool exported = false; // visible outside the module with the C calling convention
+    bool memoize = false; // calls go through a cache of results, set by the Analyzer
+    FuncFacts facts;
 
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
     
-    TrenStmt(const string& name, unique_ptr<Stmt> fb, shared_ptr<ValueType> type, vector<pair<string, shared_ptr<ValueType>>> args)
-        : name(name), func_body(std::move(fb)), retType(type), args(std::move(args)) {}
+    TrenStmt(const string& name, Symbol *sym, Stmt *fb, ValueType *type, vector<pair<string, ValueType *>> args, int nslots)
+        : name(name), sym(sym), func_body(fb), retType(type), args(std::move(args)), nslots(nslots) {}
 };
 
 
 struct RetStmt: public Stmt {
-    unique_ptr<Expr> expr;
+    Expr *expr;
 
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
 
-    RetStmt(unique_ptr<Expr> expr) : expr(std::move(expr)) {}
+    RetStmt(Expr *expr) : expr(expr) {}
 };
 
 struct IfStmt: public Stmt {
-    unique_ptr<Expr> Cond;
-    unique_ptr<Stmt> Body;
+    Expr *Cond;
+    Stmt *Body;
+    Hints hints;
 
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
 
-    IfStmt(unique_ptr<Expr> cond, unique_ptr<Stmt> body)
-        : Cond(std::move(cond)), Body(std::move(body)) {}
+    IfStmt(Expr *cond, Stmt *body, Hints hints)
+        : Cond(cond), Body(body), hints(hints) {}
 };
 
 struct AliveStmt: public Stmt {
-    unique_ptr<Expr> Cond;
-    unique_ptr<Stmt> Body;
+    Expr *Cond;
+    Stmt *Body;
+    Hints hints;
+
+    Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
+
+    AliveStmt(Expr *cond, Stmt *body, Hints hints)
+        : Cond(cond), Body(body), hints(hints) {}
+};
+
+// for[i = Start, End] Body: i runs from Start up to End exclusive, End is evaluated once
+struct ForStmt: public Stmt {
+    string name;
+    Symbol *sym;
+    Expr *Start, *End;
+    Stmt *Body;
+    Hints hints;
 
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
 
-    AliveStmt(unique_ptr<Expr> cond, unique_ptr<Stmt> body)
-        : Cond(std::move(cond)), Body(std::move(body)) {}
+    ForStmt(const string& name, Symbol *sym, Expr *start, Expr *end, Stmt *body, Hints hints)
+        : name(name), sym(sym), Start(start), End(end), Body(body), hints(hints) {}
+};
+
+// reduction clause of a fightclub loop: every worker accumulates into a private copy,
+// the copies are combined into the variable when the loop is over
+struct Reduction {
+    enum Kind { SUM, MIN, MAX } kind;
+    Symbol *sym;
+};
+
+// fightclub[i = Start, End | sum s] Body: a for loop whose iterations run in parallel
+struct FightStmt: public Stmt {
+    string name;
+    Symbol *sym;
+    Expr *Start, *End;
+    Stmt *Body;
+    Hints hints;
+    vector<Reduction> reductions;
+
+    Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
+
+    FightStmt(const string& name, Symbol *sym, Expr *start, Expr *end, Stmt *body, Hints hints, vector<Reduction> reductions)
+        : name(name), sym(sym), Start(start), End(end), Body(body), hints(hints), reductions(std::move(reductions)) {}
 };
 
 struct HighExpr: public Stmt {
-    unique_ptr<Expr> expr;
+    Expr *expr;
     
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
     
-    HighExpr(unique_ptr<Expr> expr)
-        : expr(std::move(expr)) {}
+    HighExpr(Expr *expr)
+        : expr(expr) {}
 };
 
 struct ParenStmts: public Stmt {
-    vector<unique_ptr<Stmt>> stmts;
+    vector<Stmt *> stmts;
 
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
 
-    ParenStmts(vector<unique_ptr<Stmt>> stmts)
+    ParenStmts(vector<Stmt *> stmts)
         : stmts(std::move(stmts)) {}
 };
 
 struct Input: public Node {
-    vector<unique_ptr<Stmt>> stmts;
+    vector<Stmt *> stmts;
+    int nslots; // locals of main
+    int nfuncs; // function slots, print included
+    int nglobals; // top-level variables
 
     Value *accept(ASTVisitor& visitor) { return visitor.visit(*this); }
 
-    Input(vector<unique_ptr<Stmt>> stmts)
-        : stmts(std::move(stmts)) {}
+    Input(vector<Stmt *> stmts, int nslots, int nfuncs, int nglobals)
+        : stmts(std::move(stmts)), nslots(nslots), nfuncs(nfuncs), nglobals(nglobals) {}
 };
@@ -13,6 +13,8 @@ struct ParenStmts;
 struct RetStmt;
 struct IfStmt;
 struct AliveStmt;
+struct ForStmt;
+struct FightStmt;
 struct HighExpr;
 
 struct Expr;
@@ -29,12 +31,16 @@ struct IndexExpr;
 
 struct Input;
 
+struct Symbol;
+
 struct ASTVisitor {
     virtual Value *visit(WarStmt&) = 0;
     virtual Function *visit(TrenStmt&) = 0;
     virtual Value *visit(RetStmt&) = 0;
     virtual Value *visit(IfStmt&) = 0;
     virtual Value *visit(AliveStmt&) = 0;
+    virtual Value *visit(ForStmt&) = 0;
+    virtual Value *visit(FightStmt&) = 0;
     virtual Value *visit(HighExpr&) = 0;
     virtual Value *visit(ParenStmts&) = 0;
 
@@ -11,6 +11,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
@@ -24,6 +25,7 @@
 
 
 #include "ast.hpp"
+#include "table.hpp"
 #include "visitor.hpp"
 
 #include <unordered_map>
@@ -32,14 +34,16 @@ using std::unordered_map;
 
 struct CodeVisitor: public ASTVisitor {
     Value *LogCodeError(const string&);
-    static llvm::Type *convert(shared_ptr<ValueType>);
-    static llvm::ArrayType *arr_convert(shared_ptr<ValueType>);
+    static llvm::Type *convert(ValueType *);
+    static llvm::ArrayType *arr_convert(ValueType *);
 
     Value *visit(WarStmt&);
     Function *visit(TrenStmt&);
     Value *visit(RetStmt&);
     Value *visit(IfStmt&);
     Value *visit(AliveStmt&);
+    Value *visit(ForStmt&);
+    Value *visit(FightStmt&);
     Value *visit(HighExpr&);
     Value *visit(ParenStmts&);
 
@@ -57,6 +61,7 @@ struct CodeVisitor: public ASTVisitor {
     Value *visit(Input&);
 
     unique_ptr<llvm::Module> getModule();
+    unique_ptr<llvm::LLVMContext> getContext();
     
     void run();
 };
@@ -67,17 +72,19 @@ struct AddrVisitor: public ASTVisitor {
     Value *visit(RetStmt&) { return nullptr; }
     Value *visit(IfStmt&) { return nullptr; }
     Value *visit(AliveStmt&) { return nullptr; }
+    Value *visit(ForStmt&) { return nullptr; }
+    Value *visit(FightStmt&) { return nullptr; }
     Value *visit(HighExpr&) { return nullptr; }
     Value *visit(ParenStmts&) { return nullptr; }
 
     Value *visit(AssignExpr&);
     Value *visit(BoolExpr&) { return nullptr; }
-    Value *visit(AddExpr&) { return nullptr; }
-    Value *visit(TermExpr&) { return nullptr; }
+    Value *visit(AddExpr&);
+    Value *visit(TermExpr&);
     Value *visit(IDExpr&);
     Value *visit(CallExpr&) { return nullptr; }
     Value *visit(IntExpr&) { return nullptr; }
-    Value *visit(ArrayExpr&) { return nullptr; }
+    Value *visit(ArrayExpr&);
     Value *visit(ParenExpr&);
     Value *visit(IndexExpr&);
 
@@ -85,15 +92,6 @@ struct AddrVisitor: public ASTVisitor {
 };
 
 
-struct LLSym {
-    string name;
-    llvm::Type *type;
-    llvm::AllocaInst *addr;
-
-    LLSym(const string& name, llvm::Type *type, llvm::AllocaInst *alloc)
-        : name(name), type(type), addr(alloc) {}
-};
-
 class Codegen: public CompilerPass {
 public:
     void accept(shared_ptr<IVisitor> vis) { vis->visit(*this); }
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "ast.hpp"
+#include "table.hpp"
+#include "visitor.hpp"
+
+#include "llvm/ADT/DenseMap.h"
+
+// Runs between the parser and codegen. Constant subtrees become literals, and a call
+// with constant arguments is replaced by its result when the interpreter can evaluate
+// the callee without side effects inside the fuel budget.
+// Expression visits leave the (possibly new) node in `folded` and return nullptr.
+struct FoldVisitor: public ASTVisitor {
+    Arena& arena;
+    TypeContext& types;
+
+    Expr *folded = nullptr;
+    llvm::DenseMap<Symbol *, ll> constants; // int consts with a known value
+    llvm::DenseMap<Symbol *, TrenStmt *> bodies; // functions over ints the interpreter may call
+    int64_t fuel; // interpreter steps left for the whole program
+
+    Expr *fold(Expr *);
+    Expr *literal(ll);
+
+    Value *visit(WarStmt&);
+    Function *visit(TrenStmt&);
+    Value *visit(RetStmt&);
+    Value *visit(IfStmt&);
+    Value *visit(AliveStmt&);
+    Value *visit(ForStmt&);
+    Value *visit(FightStmt&);
+    Value *visit(HighExpr&);
+    Value *visit(ParenStmts&);
+
+    Value *visit(AssignExpr&);
+    Value *visit(BoolExpr&);
+    Value *visit(AddExpr&);
+    Value *visit(TermExpr&);
+    Value *visit(IDExpr&);
+    Value *visit(CallExpr&);
+    Value *visit(IntExpr&);
+    Value *visit(ArrayExpr&);
+    Value *visit(ParenExpr&);
+    Value *visit(IndexExpr&);
+
+    Value *visit(Input&);
+
+    FoldVisitor(Arena&, TypeContext&);
+};
+
+
+class Folder: public CompilerPass {
+public:
+    void accept(shared_ptr<IVisitor> vis) { vis->visit(*this); }
+
+    Folder() {}
+};
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <unordered_map>
 #include <iostream>
 #include <vector>
 
@@ -9,9 +8,9 @@
 using std::ostream;
 
 class Lexer: public CompilerPass {
+    std::string_view text;
     size_t tsize, i = 0;
     int line = 1;
-    string text;
 
     TOKEN LexError(const string&);
 public:
@@ -19,5 +18,6 @@ public:
 
     void accept(shared_ptr<IVisitor> visitor) override { visitor->visit(*this); }
 
-    Lexer(const string& text, size_t s) : text(text), tsize(s) {}
+    // the lexer does not own the source, it has to outlive the lexer and its tokens
+    Lexer(std::string_view text) : text(text), tsize(text.size()) {}
 };
@@ -1,48 +1,74 @@
 #pragma once
 
 #include "token.hpp"
+#include "lexer.hpp"
 #include "ast.hpp"
+#include "arena.hpp"
 #include "table.hpp"
 
 class Parser: public CompilerPass {
-    vector<TOKEN> lex_tokens;
-    TOKEN CurrTok; size_t i = 0;
+    // tokens read ahead of CurrTok, kept in a small ring instead of a whole-file vector
+    static constexpr size_t LOOKAHEAD = 4;
+    
+    Lexer *lexer = nullptr;
+    TOKEN lookahead[LOOKAHEAD];
+    size_t la_head = 0, la_size = 0;
+    
+    TOKEN CurrTok;
 
+    Arena *arena = nullptr;
+    TypeContext *types = nullptr;
     shared_ptr<Table> table = make_shared<Table>();
     
+    // slot allocation for the function being parsed, owner -1 is main
+    int next_slot = 0, next_func = 0, next_global = 0, curr_owner = -1;
+    bool in_fightclub = false; // parsing the body of a parallel loop
+
+    ASTSym *declareVar(const string&, ValueType *);
+    ASTSym *declareGlobal(const string&, ValueType *);
+    ASTSym *declareFunc(const string&, ValueType *, vector<pair<string, ValueType *>>);
+    
     TOKEN nextToken();
+    TOKEN peekToken(size_t n = 1);
     
     void LogError(const string&);
-    unique_ptr<Stmt> LogStmtError(const string&);
-    unique_ptr<Expr> LogExprError(const string&);
-    shared_ptr<ValueType> LogTypeError(const string&);
+    Stmt *LogStmtError(const string&);
+    Expr *LogExprError(const string&);
+    ValueType *LogTypeError(const string&);
     
-    unique_ptr<Stmt> ParseStatement(),
-        ParseIfStmt(),
-        ParseAliveStmt(),
-        ParseParenStmts(),
-        ParseTrenStmt(),
-        ParseWarStmt(),
-        ParseRetStmt(),
-        ParseHighExpr();
-
-    unique_ptr<Expr> ParseExpression(),
-        ParseBoolExpr(),
-        ParseAddExpr(),
-        ParseTermExpr(),
-        ParseFactor(),
-        ParseIdentifier(),
-        ParseInteger(),
-        ParseTrueFalse(),
-        ParseArray(),
-        ParseParenExpr();
-
-    shared_ptr<ValueType> ParseType(bool ptr_array=false);
+    Stmt *ParseStatement(),
+        *ParseIfStmt(),
+        *ParseAliveStmt(),
+        *ParseForStmt(),
+        *ParseFightStmt(),
+        *ParseParenStmts(),
+        *ParseBody(),
+        *ParseTrenStmt(),
+        *ParseWarStmt(),
+        *ParseRetStmt(),
+        *ParseHighExpr();
+
+    Expr *ParseExpression(),
+        *ParseBoolExpr(),
+        *ParseAddExpr(),
+        *ParseTermExpr(),
+        *ParseFactor(),
+        *ParseIdentifier(),
+        *ParseInteger(),
+        *ParseTrueFalse(),
+        *ParseArray(),
+        *ParseParenExpr();
+
+    ValueType *ParseType(bool ptr_array=false, Expr **heap_size=nullptr);
+    bool ParseRange(string&, Expr *&, Expr *&, Hints&, vector<Reduction> *);
+    bool ParseHints(Hints&, bool loop, vector<Reduction> *reductions = nullptr);
 
 public:
-    unique_ptr<Input> ParseInput();
+    Input *ParseInput();
 
-    void setTokens(vector<TOKEN> toks) { lex_tokens = std::move(toks); }
+    void setLexer(Lexer *lex) { lexer = lex; }
+    void setArena(Arena *a) { arena = a; }
+    void setTypes(TypeContext *ctx) { types = ctx; }
     void accept(shared_ptr<IVisitor> visitor) { visitor->visit(*this); }
 
     Parser() {}
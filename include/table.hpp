@@ -3,74 +3,147 @@
 #include "ast.hpp"
 #include "type.hpp"
 
-using std::unordered_map;
+#include "llvm/ADT/StringMap.h"
+
+#include <string_view>
 
 struct Symbol {
     virtual const string& getName() const = 0;
-    virtual shared_ptr<ValueType> getType() const = 0;
-    virtual const vector<pair<string, shared_ptr<ValueType>>>& getArgs() const = 0;
+    virtual ValueType *getType() const = 0;
+    virtual const vector<pair<string, ValueType *>>& getArgs() const = 0;
+    virtual bool isFunction() const = 0;
+    virtual bool isConstant() const = 0;
+    virtual bool isGlobal() const = 0;
+    virtual bool isShared() const = 0;
+    virtual bool isHeap() const = 0;
+    virtual bool writesArg(size_t) const = 0;
+    virtual int getSlot() const = 0;
+    virtual int getOwner() const = 0;
     
     virtual ~Symbol() = default;
 };
 
+// Variables get a slot in the frame of the function owning them (arguments first),
+// top-level variables a slot in the module's globals and functions a slot in the
+// module's function list. Codegen indexes by slot.
 struct ASTSym: public Symbol {
     string name;
-    shared_ptr<ValueType> type;
-    vector<pair<string, shared_ptr<ValueType>>> args{};
+    ValueType *type;
+    vector<pair<string, ValueType *>> args{};
+    bool func = false;
+    bool constant = false; // cannot be assigned to
+    bool global = false; // declared at the top level of the program
+    bool shared = false; // global read or written from inside a function
+    bool heap = false; // runtime-sized array, freed when its block ends
+    unsigned written = ~0u; // arguments a function may write through, one bit each
+    int slot, owner;
 
     const string& getName() const override { return name; }
-    shared_ptr<ValueType> getType() const override { return type; }
-    const vector<pair<string, shared_ptr<ValueType>>>& getArgs() const override { return args; }
+    ValueType *getType() const override { return type; }
+    const vector<pair<string, ValueType *>>& getArgs() const override { return args; }
+    bool isFunction() const override { return func; }
+    bool isConstant() const override { return constant; }
+    bool isGlobal() const override { return global; }
+    bool isShared() const override { return shared; }
+    bool isHeap() const override { return heap; }
+    bool writesArg(size_t arg) const override { return arg >= 32 || (written >> arg & 1); }
+    int getSlot() const override { return slot; }
+    int getOwner() const override { return owner; }
     
-    ASTSym(const string& name, shared_ptr<ValueType> type)
-        : name(name), type(type) {}
-    ASTSym(const string& name, shared_ptr<ValueType> type, vector<pair<string, shared_ptr<ValueType>>> args)
-        : name(name), type(type), args(std::move(args)) {}
+    ASTSym(const string& name, ValueType *type, int slot, int owner)
+        : name(name), type(type), slot(slot), owner(owner) {}
+    ASTSym(const string& name, ValueType *type, vector<pair<string, ValueType *>> args, int slot)
+        : name(name), type(type), args(std::move(args)), func(true), slot(slot), owner(-1) {}
 };
 
-class Scope {
-    unordered_map<string, shared_ptr<Symbol>> syms;
-    string name;
-public:
-    const string& getName() const { return name; }
+using Name = unsigned;
+
+// Single open-addressing table for all open scopes.
+// Declaring a name overwrites its binding and logs the previous one,
+// leaving a scope replays the log back to where the scope started.
+class Table {
+    struct Entry {
+        Name name;
+        Symbol *sym;
+    };
+
+    static constexpr Name EMPTY = ~0u;
+
+    llvm::StringMap<Name> names;
     
-    shared_ptr<Symbol> find_symbol(const string& name) {
-        return (syms.count(name)? syms[name] : nullptr);
+    vector<Entry> entries = vector<Entry>(64, {EMPTY, nullptr});
+    size_t used = 0;
+
+    vector<Entry> undo;
+    vector<pair<size_t, string>> scopes;
+
+    size_t probe(Name name) const {
+        size_t mask = entries.size() - 1;
+        for(size_t i = (name * 0x9E3779B9u) & mask;; i = (i + 1) & mask)
+            if(entries[i].name == name || entries[i].name == EMPTY)
+                return i;
     }
 
-    void set_symbol(shared_ptr<Symbol> sym) {
-        syms[sym->getName()] = sym;
+    Entry& slot(Name name) {
+        Entry& entry = entries[probe(name)];
+        if(entry.name == EMPTY) {
+            entry.name = name;
+            ++used;
+        }
+        return entry;
     }
 
-    Scope(const string& name) : name(name) {}
-};
+    void grow() {
+        vector<Entry> old = std::move(entries);
+        entries.assign(old.size() * 2, {EMPTY, nullptr});
+        used = 0;
 
-class Table {
-    vector<shared_ptr<Scope>> stack;
+        // unbound names have nothing left in the undo log, so they can be dropped
+        for(const Entry& entry: old)
+            if(entry.name != EMPTY && entry.sym)
+                slot(entry.name).sym = entry.sym;
+    }
 public:
-    shared_ptr<Scope> enter_scope(const string& name = "main") {
-        shared_ptr<Scope> sym = make_shared<Scope>(name);
-        stack.push_back(sym);
-        return sym;
+    Name intern(std::string_view name) {
+        return names.try_emplace(name, names.size()).first->second;
+    }
+    
+    void enter_scope(const string& name = "main") {
+        scopes.push_back({undo.size(), name});
     }
 
-    shared_ptr<Symbol> find_symbol(const string& name) {
-        for(size_t i = 0, n = stack.size(); i < n; ++i)
-            if(shared_ptr<Symbol> sym = stack[i]->find_symbol(name))
-                return sym;
+    // number of open scopes, 1 at the top level of the program
+    size_t depth() const {
+        return scopes.size();
+    }
 
-        return nullptr;
+    // name of the function the current scope belongs to
+    const string& scope_name() const {
+        return scopes.back().second;
     }
 
-    void add_symbol(shared_ptr<Symbol> sym) {
-        stack.back()->set_symbol(sym);
+    Symbol *find_symbol(Name name) const {
+        const Entry& entry = entries[probe(name)];
+        return (entry.name == name? entry.sym : nullptr);
     }
 
-    shared_ptr<Scope> get_scope() {
-        return stack.back();
+    Symbol *find_symbol(std::string_view name) {
+        return find_symbol(intern(name));
+    }
+
+    void add_symbol(Symbol *sym) {
+        Entry& entry = slot(intern(sym->getName()));
+        undo.push_back(entry);
+        entry.sym = sym;
+
+        if(used * 2 > entries.size())
+            grow();
     }
     
     void exit_scope() {
-        stack.pop_back();
+        for(size_t mark = scopes.back().first; undo.size() > mark; undo.pop_back())
+            slot(undo.back().name).sym = undo.back().sym;
+
+        scopes.pop_back();
     }
 };
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 
 using std::string;
 using std::ostream;
@@ -17,7 +18,7 @@ struct TOKEN {
         // KeyWords
         IDENTIFIER, IF, ALIVE, WAR, YOU, WANT, 
         THIS, DO, NOTHING, BY, REDGAR, FIGHTCLUB, 
-        TREN, RETURN, 
+        TREN, RETURN, FOR, CONST, EXPORT,
 
         // Types
         ARRAYTYPE, INTTYPE, BOOLTYPE, NONETYPE, REALTYPE, PTRTYPE,
@@ -35,11 +36,11 @@ struct TOKEN {
     };
     
     ll ival = 0;
-    string word;
+    std::string_view word; // slice of the lexer's source text
     lexeme tok;
     int line;
 
-    TOKEN(lexeme tok, const string& word, int line) : tok(tok), word(word), line(line) {};
+    TOKEN(lexeme tok, std::string_view word, int line) : tok(tok), word(word), line(line) {};
     TOKEN(lexeme tok, ll ival, int line) : tok(tok), ival(ival), line(line) {};
     TOKEN(lexeme tok, int line) : tok(tok), line(line) {}
     TOKEN() {}
@@ -5,6 +5,10 @@
 #include <memory>
 #include <string>
 
+#include "llvm/ADT/DenseMap.h"
+
+#include "arena.hpp"
+
 using std::shared_ptr, std::unordered_map, std::unordered_set, std::string;
 
 struct ValueType {
@@ -12,7 +16,7 @@ struct ValueType {
         INT, ARRAY, NONETYPE
     };
 
-    virtual shared_ptr<ValueType> getSub() const { return nullptr; }
+    virtual ValueType *getSub() const { return nullptr; }
     virtual type get() const { return NONETYPE; }
     virtual int size() const { return 0; }
     
@@ -24,23 +28,39 @@ struct IntType: public ValueType {
 };
 
 struct ArrayType: public ValueType {
-    shared_ptr<ValueType> SubType;
+    ValueType *SubType;
     int arr_size;
 
     int size() const override { return arr_size; }
     type get() const override { return ARRAY; }
     
-    shared_ptr<ValueType> getSub() const override { return SubType; }
+    ValueType *getSub() const override { return SubType; }
 
-    ArrayType(shared_ptr<ValueType> subt, int arr_size) : SubType(subt), arr_size(arr_size) {}
+    ArrayType(ValueType *subt, int arr_size) : SubType(subt), arr_size(arr_size) {}
 };
 
 struct NoneType: public ValueType {};
 
-shared_ptr<ValueType> maxType(shared_ptr<ValueType>, shared_ptr<ValueType>);
-bool matchType(const std::string&, shared_ptr<ValueType>);
+// Every distinct type is created once and handed out by pointer,
+// so two types are equal exactly when their pointers are.
+class TypeContext {
+    Arena& arena;
+    IntType *intTy;
+    NoneType *noneTy;
+    llvm::DenseMap<std::pair<ValueType *, int>, ArrayType *> arrayTys;
+public:
+    ValueType *getInt() const { return intTy; }
+    ValueType *getNone() const { return noneTy; }
+    ValueType *getArray(ValueType *sub, int size);
+
+    TypeContext(Arena& arena)
+        : arena(arena), intTy(arena.make<IntType>()), noneTy(arena.make<NoneType>()) {}
+};
+
+ValueType *maxType(ValueType *, ValueType *);
+long long elementCount(ValueType *);
+bool matchType(const std::string&, ValueType *);
+bool sameType(ValueType *, ValueType *);
 
-bool operator==(shared_ptr<ValueType>, ValueType::type);
-bool operator!=(shared_ptr<ValueType>, ValueType::type);
-bool operator==(shared_ptr<ValueType>, shared_ptr<ValueType>);
-bool operator!=(shared_ptr<ValueType>, shared_ptr<ValueType>);
+bool operator==(ValueType *, ValueType::type);
+bool operator!=(ValueType *, ValueType::type);
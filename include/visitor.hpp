@@ -4,7 +4,9 @@
 #include <memory>
 #include <vector>
 
+#include "arena.hpp"
 #include "token.hpp"
+#include "type.hpp"
 
 #include "llvm/IR/Module.h"
 
@@ -12,6 +14,8 @@ using std::vector, std::unique_ptr, std::shared_ptr;
 
 class Lexer;
 class Parser;
+class Folder;
+class Analyzer;
 class Codegen;
 class Node;
 
@@ -19,6 +23,8 @@ class IVisitor {
 public:
     virtual void visit(Lexer&) = 0;
     virtual void visit(Parser&) = 0;
+    virtual void visit(Folder&) = 0;
+    virtual void visit(Analyzer&) = 0;
     virtual void visit(Codegen&) = 0;
 
     virtual ~IVisitor() = default;
@@ -26,12 +32,17 @@ public:
 
 class CompilerVisitor: public IVisitor {
 public:
-    vector<TOKEN> tokens;
-    unique_ptr<Node> AST;
+    Lexer *lexer = nullptr;
+    Arena arena; // owns the AST, its types and symbols
+    TypeContext types{arena};
+    Node *AST = nullptr;
+    unique_ptr<llvm::LLVMContext> ctx;
     unique_ptr<llvm::Module> mod;
 
     void visit(Lexer&) override;
     void visit(Parser&) override;
+    void visit(Folder&) override;
+    void visit(Analyzer&) override;
     void visit(Codegen&) override;
 };
 
@@ -0,0 +1,99 @@
+#include "runtime.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Heap arrays come from power-of-two size classes. Blocks are carved out of large
+// chunks and recycled through per-thread free lists, so an array declared in a loop
+// body costs a couple of loads and stores per iteration instead of a malloc/free pair.
+// Requests above the largest class go straight to the system allocator.
+
+namespace {
+
+constexpr size_t ALIGNMENT = 64; // a cache line, and an AVX-512 register
+constexpr int MIN_SHIFT = 6; // 64 bytes
+constexpr int MAX_SHIFT = 20; // 1 MiB
+constexpr size_t CHUNK_SIZE = size_t(1) << 22;
+
+struct FreeBlock {
+    FreeBlock *next;
+};
+
+[[noreturn]] void outOfMemory(size_t bytes) {
+    std::fprintf(stderr, "gars: out of memory allocating %zu bytes\n", bytes);
+    std::abort();
+}
+
+void *systemAlloc(size_t bytes) {
+    // aligned_alloc wants a multiple of the alignment
+    bytes = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    
+    void *block = std::aligned_alloc(ALIGNMENT, bytes? bytes : ALIGNMENT);
+    if(!block)
+        outOfMemory(bytes);
+
+    return block;
+}
+
+int sizeClass(size_t bytes) {
+    if(bytes <= (size_t(1) << MIN_SHIFT))
+        return MIN_SHIFT;
+
+    return 64 - __builtin_clzll(bytes - 1);
+}
+
+// chunks are never given back, the pool only grows to the program's peak usage
+struct Pool {
+    FreeBlock *free[MAX_SHIFT - MIN_SHIFT + 1] = {};
+    char *cursor = nullptr, *end = nullptr;
+
+    void *carve(size_t bytes) {
+        if(size_t(end - cursor) < bytes) {
+            cursor = static_cast<char *>(systemAlloc(CHUNK_SIZE));
+            end = cursor + CHUNK_SIZE;
+        }
+
+        void *block = cursor;
+        cursor += bytes;
+        
+        return block;
+    }
+};
+
+thread_local Pool pool;
+
+}
+
+extern "C" void *gars_alloc(int64_t bytes) {
+    size_t size = (bytes > 0? size_t(bytes) : 0);
+    int shift = sizeClass(size);
+
+    void *block;
+    if(shift > MAX_SHIFT)
+        block = systemAlloc(size);
+    else if(FreeBlock *&head = pool.free[shift - MIN_SHIFT]) {
+        block = head;
+        head = head->next;
+    }
+    else
+        block = pool.carve(size_t(1) << shift);
+
+    return std::memset(block, 0, size);
+}
+
+extern "C" void gars_free(void *block, int64_t bytes) {
+    size_t size = (bytes > 0? size_t(bytes) : 0);
+    int shift = sizeClass(size);
+
+    if(shift > MAX_SHIFT) {
+        std::free(block);
+        return;
+    }
+
+    // a block freed on another thread simply joins that thread's pool
+    FreeBlock *&head = pool.free[shift - MIN_SHIFT];
+    auto *freed = static_cast<FreeBlock *>(block);
+    freed->next = head;
+    head = freed;
+}
@@ -0,0 +1,120 @@
+#include "runtime.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#include <unistd.h>
+
+// print and echo append to one large buffer that goes out with a single write(2)
+// when it fills up and once more when the program exits, so printing a value is a
+// digit conversion and a copy instead of a trip through printf and stdio.
+
+namespace {
+
+constexpr size_t BUFFER_SIZE = size_t(1) << 16;
+constexpr size_t MAX_LINE = 32; // "Output: ", 20 characters of an int64 and '\n'
+
+const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// writes the digits of value ending right before end, returns where they start
+char *formatInt(char *end, int64_t value) {
+    // negated as unsigned so INT64_MIN does not overflow
+    uint64_t rest = (value < 0? 0 - uint64_t(value) : uint64_t(value));
+
+    while(rest >= 100) {
+        end -= 2;
+        std::memcpy(end, DIGIT_PAIRS + (rest % 100) * 2, 2);
+        rest /= 100;
+    }
+
+    if(rest >= 10) {
+        end -= 2;
+        std::memcpy(end, DIGIT_PAIRS + rest * 2, 2);
+    }
+    else
+        *--end = char('0' + rest);
+
+    if(value < 0)
+        *--end = '-';
+
+    return end;
+}
+
+class Output {
+    char buffer[BUFFER_SIZE];
+    size_t used = 0;
+
+    // fightclub bodies print from the pool's threads
+    std::mutex lock;
+
+    void drain() {
+        for(size_t done = 0; done < used;) {
+            ssize_t n = ::write(STDOUT_FILENO, buffer + done, used - done);
+            if(n < 0 && errno == EINTR)
+                continue;
+            // nowhere left to report a closed or full stdout, the output is dropped
+            if(n <= 0)
+                break;
+
+            done += size_t(n);
+        }
+
+        used = 0;
+    }
+public:
+    void line(const char *prefix, size_t prefix_len, int64_t value) {
+        char digits[MAX_LINE];
+        char *end = digits + sizeof(digits);
+        *--end = '\n';
+        char *start = formatInt(end, value);
+        size_t len = size_t(digits + sizeof(digits) - start);
+
+        std::lock_guard<std::mutex> guard(lock);
+        if(used + prefix_len + len > BUFFER_SIZE)
+            drain();
+
+        std::memcpy(buffer + used, prefix, prefix_len);
+        std::memcpy(buffer + used + prefix_len, start, len);
+        used += prefix_len + len;
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> guard(lock);
+        drain();
+    }
+
+    ~Output() {
+        flush();
+    }
+};
+
+// static storage, destroyed (and so flushed) when main returns or exit is called
+Output output;
+
+}
+
+extern "C" int64_t gars_print(int64_t value) {
+    static const char prefix[] = "Output: ";
+    output.line(prefix, sizeof(prefix) - 1, value);
+    return 0;
+}
+
+extern "C" int64_t gars_echo(int64_t value) {
+    output.line("", 0, value);
+    return 0;
+}
+
+extern "C" void gars_flush() {
+    output.flush();
+}
@@ -0,0 +1,183 @@
+#include "runtime.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool for fightclub loops. A range is split in halves down to a grain
+// size: the half that is not run right away goes to the back of the running thread's
+// deque, idle threads steal from the front of other deques, so big chunks move and
+// small ones stay local. A thread waiting for its loop keeps running tasks, which
+// also lets a fightclub inside a called function run on the same pool.
+
+namespace {
+
+struct Job {
+    gars_body body;
+    void *ctx;
+    int64_t grain;
+    std::atomic<int64_t> remaining; // iterations not finished yet
+};
+
+struct Task {
+    Job *job;
+    int64_t begin, end;
+};
+
+struct Deque {
+    std::mutex lock;
+    std::deque<Task> tasks;
+};
+
+class Pool {
+    // deque 0 is shared by threads outside the pool, worker k owns deque k
+    std::vector<Deque> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex sleep;
+    std::condition_variable wake;
+    std::atomic<int64_t> queued{0};
+    bool stop = false;
+
+    static thread_local size_t self;
+
+    void push(size_t queue, const Task& task) {
+        {
+            std::lock_guard<std::mutex> guard(queues[queue].lock);
+            queues[queue].tasks.push_back(task);
+        }
+
+        queued.fetch_add(1, std::memory_order_release);
+        std::lock_guard<std::mutex> guard(sleep);
+        wake.notify_one();
+    }
+
+    // own deque from the back, then the others from the front
+    bool take(Task& task) {
+        for(size_t i = 0, n = queues.size(); i < n; ++i) {
+            Deque& queue = queues[(self + i) % n];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if(queue.tasks.empty())
+                continue;
+
+            if(i == 0) {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            else {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+            
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        return false;
+    }
+
+    void run(Task task) {
+        Job *job = task.job;
+        
+        while(task.end - task.begin > job->grain) {
+            int64_t mid = task.begin + (task.end - task.begin) / 2;
+            push(self, {job, mid, task.end});
+            task.end = mid;
+        }
+
+        job->body(job->ctx, task.begin, task.end);
+        job->remaining.fetch_sub(task.end - task.begin, std::memory_order_acq_rel);
+    }
+
+    void work(size_t id) {
+        self = id;
+        
+        while(true) {
+            Task task;
+            if(take(task)) {
+                run(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(sleep);
+            wake.wait(guard, [this] { return stop || queued.load(std::memory_order_acquire) > 0; });
+            if(stop)
+                return;
+        }
+    }
+
+public:
+    Pool(size_t threads): queues(threads + 1) {
+        for(size_t id = 1; id <= threads; ++id)
+            workers.emplace_back(&Pool::work, this, id);
+    }
+
+    ~Pool() {
+        {
+            std::lock_guard<std::mutex> guard(sleep);
+            stop = true;
+        }
+        wake.notify_all();
+        
+        for(std::thread& worker: workers)
+            worker.join();
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    void parallelFor(gars_body body, void *ctx, int64_t begin, int64_t end) {
+        // a few chunks per thread leave room to balance uneven iterations
+        int64_t grain = std::max<int64_t>(1, (end - begin) / int64_t(8 * (workers.size() + 1)));
+        Job job{body, ctx, grain, {end - begin}};
+
+        run({&job, begin, end});
+
+        while(job.remaining.load(std::memory_order_acquire) > 0) {
+            Task task;
+            if(take(task))
+                run(task);
+            else
+                std::this_thread::yield();
+        }
+    }
+};
+
+thread_local size_t Pool::self = 0;
+
+size_t threadCount() {
+    if(const char *env = std::getenv("GARS_THREADS")) {
+        long threads = std::atol(env);
+        if(threads > 0)
+            return size_t(threads);
+    }
+    
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+Pool& pool() {
+    // the calling thread takes part too, so one thread fewer is started
+    static Pool instance(threadCount() - 1);
+    return instance;
+}
+
+}
+
+extern "C" void gars_parallel_for(gars_body body, void *ctx, int64_t begin, int64_t end) {
+    if(begin >= end)
+        return;
+
+    Pool& workers = pool();
+    if(workers.size() == 0 || end - begin == 1) {
+        body(ctx, begin, end);
+        return;
+    }
+
+    workers.parallelFor(body, ctx, begin, end);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+// Support library of compiled programs. Object files are linked against
+// libgars_rt.a, the compiler links it in as well and hands it to the JIT for -run.
+extern "C" {
+
+// zeroed block of at least bytes, aligned for the widest vector registers
+void *gars_alloc(int64_t bytes);
+
+// bytes must be the size the block was allocated with
+void gars_free(void *block, int64_t bytes);
+
+// print writes "Output: <value>\n", echo just "<value>\n"; both return 0.
+// Output is buffered and flushed when full and at exit, gars_flush forces it out.
+int64_t gars_print(int64_t value);
+int64_t gars_echo(int64_t value);
+void gars_flush(void);
+
+// body of a fightclub loop, runs the iterations [begin, end)
+typedef void (*gars_body)(void *ctx, int64_t begin, int64_t end);
+
+// runs body over [begin, end) on the thread pool and returns when every iteration is done;
+// the pool has GARS_THREADS workers (default: one per hardware thread)
+void gars_parallel_for(gars_body body, void *ctx, int64_t begin, int64_t end);
+
+}
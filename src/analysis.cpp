@@ -0,0 +1,386 @@
+#include "../include/analysis.hpp"
+
+#include <unordered_set>
+
+using std::unordered_set;
+
+// Arrays a function got as arguments belong to its callers: the index of the argument,
+// -1 for anything else. Past 32 arguments they are tracked as globals.
+int EffectVisitor::argument(Symbol *sym) const {
+    if(!curr || sym->isGlobal() || sym->getType() != ValueType::ARRAY || sym->getOwner() != curr->tren->sym->getSlot())
+        return -1;
+
+    return (sym->getSlot() < (int)curr->tren->args.size()? sym->getSlot() : -1);
+}
+
+// the array an array argument lives in, null for a temporary
+Symbol *EffectVisitor::arrayRoot(Expr *expr) {
+    while(auto *paren = dynamic_cast<ParenExpr *>(expr))
+        expr = paren->expr;
+
+    if(auto *id = dynamic_cast<IDExpr *>(expr))
+        return id->sym;
+
+    // a row of a bigger array
+    if(auto *index = dynamic_cast<IndexExpr *>(expr)) {
+        for(Expr *idx: index->Idxs)
+            idx->accept(*this);
+
+        return index->sym;
+    }
+
+    return nullptr;
+}
+
+void EffectVisitor::read(Symbol *sym) {
+    if(!curr)
+        return;
+
+    int arg = argument(sym);
+    if(arg >= 32 || (sym->isGlobal() && !sym->isConstant()))
+        curr->reads_global = true;
+    else if(sym->isGlobal())
+        curr->reads_const = true;
+    else if(arg >= 0)
+        curr->reads_args |= 1u << arg;
+}
+
+void EffectVisitor::write(Symbol *sym) {
+    if(!curr)
+        return;
+
+    int arg = argument(sym);
+    if(arg >= 32 || sym->isGlobal())
+        curr->writes_global = true;
+    else if(arg >= 0)
+        curr->writes_args |= 1u << arg;
+}
+
+// applies to an array what the callee does to its argument
+void EffectVisitor::forward(Effects& eff, const Forward& fw) {
+    Effects& callee = effects[fw.callee];
+
+    // an enclosing function is not summarized yet and may do anything
+    bool reads = true, writes = true;
+    if((callee.resolved || &callee == &eff) && fw.pos < 32) {
+        reads = callee.reads_args >> fw.pos & 1;
+        writes = callee.writes_args >> fw.pos & 1;
+    }
+
+    Effects *outer = curr;
+    curr = &eff;
+    if(reads)
+        read(fw.array);
+    if(writes)
+        write(fw.array);
+    curr = outer;
+}
+
+Value *EffectVisitor::visit(WarStmt& war) {
+    // heap arrays come from the runtime's allocator
+    if(war.size) {
+        war.size->accept(*this);
+        if(curr)
+            curr->runtime = true;
+    }
+
+    if(war.value)
+        war.value->accept(*this);
+
+    return nullptr;
+}
+
+Function *EffectVisitor::visit(TrenStmt& tren) {
+    Effects *outer = curr;
+    bool outer_fightclub = in_fightclub;
+
+    curr = &effects[tren.sym];
+    curr->tren = &tren;
+    in_fightclub = false;
+
+    tren.func_body->accept(*this);
+    order.push_back(tren.sym);
+
+    curr = outer;
+    in_fightclub = outer_fightclub;
+
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(RetStmt& ret) {
+    ret.expr->accept(*this);
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(IfStmt& ifstmt) {
+    ifstmt.Cond->accept(*this);
+    ifstmt.Body->accept(*this);
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(AliveStmt& alive) {
+    if(curr)
+        curr->loops = true;
+
+    alive.Cond->accept(*this);
+    alive.Body->accept(*this);
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(ForStmt& forstmt) {
+    forstmt.Start->accept(*this);
+    forstmt.End->accept(*this);
+    forstmt.Body->accept(*this);
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(FightStmt& fight) {
+    fight.Start->accept(*this);
+    fight.End->accept(*this);
+
+    if(curr)
+        curr->runtime = true;
+
+    bool outer_fightclub = in_fightclub;
+    in_fightclub = true;
+    fight.Body->accept(*this);
+    in_fightclub = outer_fightclub;
+
+    // reductions write their variable from every worker
+    for(auto& red: fight.reductions)
+        write(red.sym);
+
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(HighExpr& hexpr) {
+    hexpr.expr->accept(*this);
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(ParenStmts& parens) {
+    for(Stmt *stmt: parens.stmts)
+        stmt->accept(*this);
+
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(AssignExpr& assign) {
+    Expr *target = assign.LHS;
+    while(auto *paren = dynamic_cast<ParenExpr *>(target))
+        target = paren->expr;
+
+    if(auto *index = dynamic_cast<IndexExpr *>(target)) {
+        for(Expr *idx: index->Idxs)
+            idx->accept(*this);
+
+        write(index->sym);
+    }
+    else if(auto *id = dynamic_cast<IDExpr *>(target))
+        write(id->sym);
+    else if(curr) {
+        // a store through anything else may hit any memory the function can reach
+        target->accept(*this);
+        curr->writes_global = true;
+        curr->writes_args = ~0u;
+    }
+
+    assign.RHS->accept(*this);
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(BoolExpr& boolexpr) {
+    boolexpr.LHS->accept(*this);
+    boolexpr.RHS->accept(*this);
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(AddExpr& add) {
+    add.LHS->accept(*this);
+    add.RHS->accept(*this);
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(TermExpr& term) {
+    term.LHS->accept(*this);
+    term.RHS->accept(*this);
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(IDExpr& idexpr) {
+    read(idexpr.sym);
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(CallExpr& callexpr) {
+    if(in_fightclub)
+        parallel.push_back(callexpr.sym);
+
+    // builtins: print and echo write the output, the array ones read the arrays they
+    // get and write the ones they fill
+    auto callee = effects.find(callexpr.sym);
+    bool builtin = (callee == effects.end());
+
+    for(size_t i = 0; i < callexpr.args.size(); ++i) {
+        Expr *arg = callexpr.args[i];
+
+        Symbol *array = (arg->getType() == ValueType::ARRAY? arrayRoot(arg) : nullptr);
+        if(!array)
+            arg->accept(*this);
+        else if(!builtin) {
+            if(curr)
+                curr->forwards.push_back({callexpr.sym, (unsigned)i, array});
+        }
+        else if(callexpr.sym->writesArg(i))
+            write(array);
+        else
+            read(array);
+    }
+
+    if(!curr)
+        return nullptr;
+
+    if(builtin)
+        curr->output = curr->output || callexpr.name == "print" || callexpr.name == "echo";
+    else if(callee->second.tren == curr->tren)
+        ++curr->self_calls;
+    else
+        curr->callees.push_back(callexpr.sym);
+
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(IntExpr&) {
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(ArrayExpr& array) {
+    for(Expr *elem: array.elements)
+        elem->accept(*this);
+
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(ParenExpr& paren) {
+    paren.expr->accept(*this);
+    return nullptr;
+}
+
+Value *EffectVisitor::visit(IndexExpr& index) {
+    for(Expr *idx: index.Idxs)
+        idx->accept(*this);
+
+    read(index.sym);
+    return nullptr;
+}
+
+void EffectVisitor::resolve() {
+    // the cache is not synchronized, so nothing a fightclub body reaches is memoized
+    unordered_set<Symbol *> shared;
+    for(vector<Symbol *> work = parallel; !work.empty();) {
+        Symbol *sym = work.back();
+        work.pop_back();
+
+        auto eff = effects.find(sym);
+        if(eff == effects.end() || !shared.insert(sym).second)
+            continue;
+
+        work.insert(work.end(), eff->second.callees.begin(), eff->second.callees.end());
+    }
+
+    // callees end before their callers, so one pass in order sees every callee summarized,
+    // except an enclosing function called from a nested one
+    for(Symbol *sym: order) {
+        Effects& eff = effects[sym];
+        TrenStmt& tren = *eff.tren;
+
+        for(const Forward& fw: eff.forwards)
+            if(fw.callee != sym)
+                forward(eff, fw);
+
+        // arrays passed back into the function itself: repeat until the bits settle
+        for(unsigned reads = ~0u, writes = ~0u; reads != eff.reads_args || writes != eff.writes_args;) {
+            reads = eff.reads_args;
+            writes = eff.writes_args;
+
+            for(const Forward& fw: eff.forwards)
+                if(fw.callee == sym)
+                    forward(eff, fw);
+        }
+
+        bool known = true, willreturn = true, norecurse = true;
+        for(Symbol *callee: eff.callees) {
+            Effects& sub = effects[callee];
+            if(!sub.resolved) {
+                known = false;
+                continue;
+            }
+
+            eff.output |= sub.output;
+            eff.runtime |= sub.runtime;
+            eff.cache |= sub.cache;
+            eff.reads_global |= sub.reads_global;
+            eff.writes_global |= sub.writes_global;
+            eff.reads_const |= sub.reads_const;
+
+            willreturn = willreturn && sub.tren->facts.willreturn;
+            norecurse = norecurse && sub.tren->facts.norecurse;
+        }
+
+        if(!known)
+            eff.output = eff.runtime = eff.reads_global = eff.writes_global = true;
+
+        bool ints = (tren.retType == ValueType::INT);
+        for(auto& arg: tren.args)
+            ints = ints && (arg.second == ValueType::INT);
+
+        bool pure = !eff.output && !eff.reads_global && !eff.writes_global && !eff.reads_args && !eff.writes_args;
+        
+        tren.memoize = ints && pure && !shared.count(sym) && eff.self_calls >= 2;
+        eff.cache |= tren.memoize;
+
+        FuncFacts& facts = tren.facts;
+        facts.argmem = eff.reads_args || eff.writes_args;
+        facts.globals = eff.reads_global || eff.writes_global || eff.reads_const || eff.cache;
+        facts.inaccessible = eff.output || eff.runtime;
+        facts.writes = eff.writes_args || eff.writes_global || eff.output || eff.runtime || eff.cache;
+
+        // for loops always end, alive loops and recursion may not; the runtime can abort
+        facts.willreturn = known && willreturn && !eff.loops && !eff.runtime && eff.self_calls == 0;
+        facts.norecurse = known && norecurse && eff.self_calls == 0;
+
+        unsigned arrays = 0;
+        for(size_t i = 0; i < tren.args.size() && i < 32; ++i)
+            if(tren.args[i].second == ValueType::ARRAY)
+                arrays |= 1u << i;
+
+        facts.readonly = arrays & ~eff.writes_args;
+
+        // noalias holds when no other access to the same memory can be a write: arrays
+        // written through other arguments or globals, or this one while globals are read
+        facts.noalias = 0;
+        for(unsigned i = 0; i < 32; ++i) {
+            if(!(arrays >> i & 1))
+                continue;
+
+            bool writes = eff.writes_args >> i & 1;
+            bool alone = !eff.writes_global && !(writes && eff.reads_global);
+            for(unsigned j = 0; j < 32; ++j)
+                if(j != i && (arrays >> j & 1))
+                    alone = alone && !writes && !(eff.writes_args >> j & 1);
+
+            if(alone)
+                facts.noalias |= 1u << i;
+        }
+
+        eff.resolved = true;
+    }
+}
+
+Value *EffectVisitor::visit(Input& inp) {
+    for(Stmt *stmt: inp.stmts)
+        stmt->accept(*this);
+
+    resolve();
+    return nullptr;
+}
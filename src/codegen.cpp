@@ -17,47 +17,131 @@ unique_ptr<Module> CodeVisitor::getModule() {
     return std::move(TheModule);
 }
 
-using LLTableSymbol = unordered_map<string, shared_ptr<LLSym>>;
+unique_ptr<LLVMContext> CodeVisitor::getContext() {
+    return std::move(LLCTX);
+}
+
+// addresses of the locals of the function being generated, indexed by the symbol slot
+static vector<Value *> slots;
+
+// top-level variables: module globals, or allocas of main when no function uses them
+static vector<Value *> globals;
+
+// every function of the module, indexed by the symbol slot
+static vector<Function *> functions;
+
+// loop header of the function being generated, self tail calls jump back to it
+static BasicBlock *recurseBB = nullptr;
+
+// runtime allocator and thread pool, see runtime/runtime.hpp
+static Function *AllocF, *FreeF, *ParallelF;
 
-vector<LLTableSymbol> stack;
+// Set while the body of a fightclub is generated. The body is a function of its own:
+// variables of the enclosing function are reached through the addresses passed in ctx.
+struct Capture {
+    Function *func = nullptr;
+    Value *ctx = nullptr;
+    vector<int> used; // slots the body loads from ctx
+    DenseMap<Symbol *, Value *> privates; // reduction accumulators of the body
+};
 
-void enter_scope() {
-    stack.push_back({});
+static Capture capture;
+
+// heap arrays of the blocks open in the function being generated, innermost last
+static vector<vector<pair<Value *, Value *>>> cleanups;
+
+static void emitFrees(const vector<pair<Value *, Value *>>& block) {
+    for(auto it = block.rbegin(); it != block.rend(); ++it)
+        Builder->CreateCall(FreeF, { it->first, it->second });
+}
+
+static void enterBlock() {
+    cleanups.emplace_back();
 }
 
-void add_symbol(shared_ptr<LLSym> llsym) {    
-    stack.back()[llsym->name] = llsym;
+// frees the block's heap arrays when control falls out of it; a return frees them itself
+static void exitBlock() {
+    if(!Builder->GetInsertBlock()->getTerminator())
+        emitFrees(cleanups.back());
+
+    cleanups.pop_back();
 }
 
-shared_ptr<LLSym> find_symbol(const string& name) {
-    for(size_t i = stack.size() - 1; i >= 0; --i)
-        if(stack[i].count(name))
-            return stack[i][name];
+// All allocas go to the top of the entry block: they are allocated once per call
+// even when declared inside a loop, and mem2reg/SROA only promote entry-block allocas.
+static AllocaInst *CreateEntryBlockAlloca(Type *type, const string& name = "") {
+    BasicBlock& entry = Builder->GetInsertBlock()->getParent()->getEntryBlock();
+    IRBuilder<> TmpB(&entry, entry.begin());
     
-    return nullptr;
+    return TmpB.CreateAlloca(type, nullptr, name);
 }
 
-void exit_scope() {
-    stack.pop_back();
+static Value *captureSlot(int slot) {
+    BasicBlock& entry = capture.func->getEntryBlock();
+    IRBuilder<> TmpB(&entry, entry.begin());
+    
+    capture.used.push_back(slot);
+    
+    Type *ptrTy = PointerType::get(*LLCTX, 0);
+    return TmpB.CreateLoad(ptrTy, TmpB.CreateConstInBoundsGEP1_64(ptrTy, capture.ctx, slot));
 }
 
+static Value *symbolAddr(Symbol *sym) {
+    if(capture.func) {
+        auto priv = capture.privates.find(sym);
+        if(priv != capture.privates.end())
+            return priv->second;
+    }
+    
+    if(sym->isGlobal())
+        return globals[sym->getSlot()];
+
+    Value *&addr = slots[sym->getSlot()];
+    if(!addr && capture.func)
+        addr = captureSlot(sym->getSlot());
+    
+    return addr;
+}
+
+static GlobalVariable *CreateGlobal(Type *type, bool constant, Constant *init, const string& name,
+                                    GlobalValue::LinkageTypes linkage = GlobalValue::InternalLinkage) {
+    auto *GV = new GlobalVariable(*TheModule, type, constant, linkage, init, name);
+    
+    // nothing in the language can compare addresses, so identical constants may be merged
+    if(constant)
+        GV->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+    
+    return GV;
+}
 
-Type *CodeVisitor::convert(shared_ptr<ValueType> tval) {
+// ValueTypes are interned, so the lowered type can be cached by pointer
+static DenseMap<ValueType *, Type *> typeCache;
+
+Type *CodeVisitor::convert(ValueType *tval) {
+    auto cached = typeCache.find(tval);
+    if(cached != typeCache.end())
+        return cached->second;
+    
+    Type *llType;
     switch(tval->get()) {
     case ValueType::INT:
-        return Type::getInt64Ty(*LLCTX);
+        llType = Type::getInt64Ty(*LLCTX);
+        break;
     case ValueType::ARRAY: {
         if(tval->size() == 0)
-            return PointerType::get(convert(tval->getSub()), 0);
+            llType = PointerType::get(convert(tval->getSub()), 0);
         else
-            return llvm::ArrayType::get(convert(tval->getSub()), tval->size());
+            llType = llvm::ArrayType::get(convert(tval->getSub()), tval->size());
+        break;
     }
         
     default: return nullptr;
     }
+
+    return typeCache[tval] = llType;
 }
 
-llvm::ArrayType *CodeVisitor::arr_convert(shared_ptr<ValueType> arrType) {
+llvm::ArrayType *CodeVisitor::arr_convert(ValueType *arrType) {
     return llvm::ArrayType::get(convert(arrType->getSub()), arrType->size());
 }
 
@@ -70,23 +154,43 @@ void CodeVisitor::run() {
     LLCTX = std::make_unique<LLVMContext>();
     TheModule = std::make_unique<Module>("Module", *LLCTX);
     Builder = std::make_unique<IRBuilder<>>(*LLCTX);
+    typeCache.clear();
 
-    FunctionType *printf_ft = FunctionType::get(Type::getInt64Ty(*LLCTX), { PointerType::get(Type::getInt8Ty(*LLCTX), 0) }, true);
-    Function *printf_f = Function::Create(printf_ft, Function::ExternalLinkage, "printf", TheModule.get());
-
+    // print and echo only touch the runtime's output buffer, so values the program
+    // keeps in memory stay in registers across them
     FunctionType *print_ft = FunctionType::get(Type::getInt64Ty(*LLCTX), { Type::getInt64Ty(*LLCTX) }, false);
-    Function *print_f = Function::Create(print_ft, Function::ExternalLinkage, "print", TheModule.get());
-
-    BasicBlock *print_mainbb = BasicBlock::Create(*LLCTX, "entry", print_f);
-
-    Builder->SetInsertPoint(print_mainbb);
-
-    Builder->CreateCall(printf_f, {
-            Builder->CreateGlobalStringPtr("Output: %i\n", "out"),
-            print_f->getArg(0)
-        }, "calltmp");
+    Function *print_f = Function::Create(print_ft, Function::ExternalLinkage, "gars_print", TheModule.get());
+    Function *echo_f = Function::Create(print_ft, Function::ExternalLinkage, "gars_echo", TheModule.get());
+    
+    for(Function *F: { print_f, echo_f }) {
+        F->addFnAttr(Attribute::NoUnwind);
+        F->setOnlyAccessesInaccessibleMemory();
+    }
 
-    Builder->CreateRet(ConstantInt::get(*LLCTX, APInt(64, 0)));
+    // declared as an allocator pair, so unused arrays and loads of untouched zeroed memory fold away
+    FunctionType *alloc_ft = FunctionType::get(PointerType::get(*LLCTX, 0), { Type::getInt64Ty(*LLCTX) }, false);
+    AllocF = Function::Create(alloc_ft, Function::ExternalLinkage, "gars_alloc", TheModule.get());
+    AllocF->addRetAttr(Attribute::NoAlias);
+    AllocF->addRetAttr(Attribute::getWithAlignment(*LLCTX, Align(64)));
+    AllocF->addFnAttr(Attribute::NoUnwind);
+    AllocF->addFnAttr(Attribute::getWithAllocSizeArgs(*LLCTX, 0, std::nullopt));
+    AllocF->addFnAttr(Attribute::getWithAllocKind(*LLCTX, AllocFnKind::Alloc | AllocFnKind::Zeroed));
+    AllocF->addFnAttr("alloc-family", "gars");
+    AllocF->setOnlyAccessesInaccessibleMemory();
+
+    FunctionType *free_ft = FunctionType::get(Type::getVoidTy(*LLCTX), { PointerType::get(*LLCTX, 0), Type::getInt64Ty(*LLCTX) }, false);
+    FreeF = Function::Create(free_ft, Function::ExternalLinkage, "gars_free", TheModule.get());
+    FreeF->addParamAttr(0, Attribute::AllocatedPointer);
+    FreeF->addFnAttr(Attribute::NoUnwind);
+    FreeF->addFnAttr(Attribute::getWithAllocKind(*LLCTX, AllocFnKind::Free));
+    FreeF->addFnAttr("alloc-family", "gars");
+    FreeF->setOnlyAccessesInaccessibleMemOrArgMem();
+
+    FunctionType *parallel_ft = FunctionType::get(Type::getVoidTy(*LLCTX), {
+            PointerType::get(*LLCTX, 0), PointerType::get(*LLCTX, 0), Type::getInt64Ty(*LLCTX), Type::getInt64Ty(*LLCTX)
+        }, false);
+    ParallelF = Function::Create(parallel_ft, Function::ExternalLinkage, "gars_parallel_for", TheModule.get());
+    ParallelF->addFnAttr(Attribute::NoUnwind);
     
     FunctionType *main_ft = FunctionType::get(Type::getInt64Ty(*LLCTX), false);
     Function *main_f = Function::Create(main_ft, Function::ExternalLinkage, "main", TheModule.get());
@@ -94,35 +198,418 @@ void CodeVisitor::run() {
     BasicBlock *mainbb = BasicBlock::Create(*LLCTX, "entry", main_f);
 
     Builder->SetInsertPoint(mainbb);
-    
-    enter_scope();
+
+    functions.assign({ print_f, echo_f });
 }
 
-Value *CodeVisitor::visit(Input& inp) {    
+Value *CodeVisitor::visit(Input& inp) {
+    slots.assign(inp.nslots, nullptr);
+    globals.assign(inp.nglobals, nullptr);
+    functions.resize(inp.nfuncs);
+    cleanups.clear();
+
+    enterBlock();
     for(size_t i = 0, s = inp.stmts.size(); i < s; ++i) {
         Value *stmtV = inp.stmts[i]->accept(*this);
     }
+    exitBlock();
 
     Builder->CreateRet(ConstantInt::get(*LLCTX, APInt(64, 0)));
     
     return ConstantInt::get(*LLCTX, APInt(64, 0));
 }
 
+static Value *emitCountedLoop(Value *n, Value *init, function_ref<Value *(Value *, Value *)> step,
+                              MDNode *loopID = nullptr);
+static bool emitArgs(CallExpr&, Function *, CodeVisitor&, std::vector<Value *>&);
+
+// Integer literals and arithmetic on them: the IRBuilder folds these to a Constant
+// without emitting any instruction, so they can be evaluated speculatively.
+// Element-wise arithmetic on arrays goes through a temporary and is never constant.
+static bool isConstantExpr(Expr *expr) {
+    if(dynamic_cast<IntExpr *>(expr))
+        return true;
+    if(auto *paren = dynamic_cast<ParenExpr *>(expr))
+        return isConstantExpr(paren->expr);
+    if(expr->getType() != ValueType::INT && !dynamic_cast<ArrayExpr *>(expr))
+        return false;
+    if(auto *add = dynamic_cast<AddExpr *>(expr))
+        return isConstantExpr(add->LHS) && isConstantExpr(add->RHS);
+    if(auto *term = dynamic_cast<TermExpr *>(expr))
+        return isConstantExpr(term->LHS) && isConstantExpr(term->RHS);
+    if(auto *boolexpr = dynamic_cast<BoolExpr *>(expr))
+        return isConstantExpr(boolexpr->LHS) && isConstantExpr(boolexpr->RHS);
+    if(auto *array = dynamic_cast<ArrayExpr *>(expr)) {
+        for(Expr *elem: array->elements)
+            if(!isConstantExpr(elem))
+                return false;
+
+        return !array->elements.empty();
+    }
+
+    return false;
+}
+
+// initializer of a global, only for expressions isConstantExpr accepts
+static Constant *constantValue(Expr *value, CodeVisitor& code_vis) {
+    while(auto *paren = dynamic_cast<ParenExpr *>(value))
+        value = paren->expr;
+
+    if(auto *array = dynamic_cast<ArrayExpr *>(value)) {
+        vector<Constant *> elems;
+        for(Expr *elem: array->elements)
+            elems.push_back(constantValue(elem, code_vis));
+
+        return ConstantArray::get(cast<llvm::ArrayType>(CodeVisitor::convert(array->type)), elems);
+    }
+
+    return cast<Constant>(value->accept(code_vis));
+}
+
+static void collectLeaves(ArrayExpr& array, vector<Value *>& path, vector<pair<vector<Value *>, Expr *>>& leaves) {
+    for(size_t i = 0, e = array.elements.size(); i < e; ++i) {
+        path.push_back(ConstantInt::get(*LLCTX, APInt(64, i)));
+
+        Expr *elem = array.elements[i];
+        while(auto *paren = dynamic_cast<ParenExpr *>(elem))
+            elem = paren->expr;
+
+        if(auto *sub = dynamic_cast<ArrayExpr *>(elem))
+            collectLeaves(*sub, path, leaves);
+        else
+            leaves.push_back({path, elem});
+
+        path.pop_back();
+    }
+}
+
+static bool isElementwise(Expr *expr) {
+    while(auto *paren = dynamic_cast<ParenExpr *>(expr))
+        expr = paren->expr;
+
+    return expr->getType() == ValueType::ARRAY && (dynamic_cast<AddExpr *>(expr) || dynamic_cast<TermExpr *>(expr));
+}
+
+// address of an array-valued operand, values without one (calls) go through a temporary
+static Value *arrayAddr(Expr *expr, CodeVisitor& code_vis) {
+    AddrVisitor addr_vis;
+    if(Value *addr = expr->accept(addr_vis))
+        return addr;
+
+    Value *arrV = expr->accept(code_vis);
+    if(!arrV)
+        return nullptr;
+
+    AllocaInst *tmp = CreateEntryBlockAlloca(arrV->getType(), "arrtemp");
+    Builder->CreateStore(arrV, tmp);
+    
+    return tmp;
+}
+
+// Leaves of an element-wise tree: arrays by the address of their first element,
+// integers by value. All are evaluated once, ahead of the loop.
+static bool collectOperands(Expr *expr, DenseMap<Expr *, Value *>& operands, CodeVisitor& code_vis) {
+    while(auto *paren = dynamic_cast<ParenExpr *>(expr))
+        expr = paren->expr;
+
+    if(isElementwise(expr)) {
+        auto *add = dynamic_cast<AddExpr *>(expr);
+        auto *term = dynamic_cast<TermExpr *>(expr);
+        
+        return collectOperands(add? add->LHS : term->LHS, operands, code_vis)
+            && collectOperands(add? add->RHS : term->RHS, operands, code_vis);
+    }
+
+    Value *operand = (expr->getType() == ValueType::ARRAY? arrayAddr(expr, code_vis) : expr->accept(code_vis));
+    operands[expr] = operand;
+    
+    return operand != nullptr;
+}
+
+static Value *emitElement(Expr *expr, Value *i, DenseMap<Expr *, Value *>& operands, MDNode *group) {
+    while(auto *paren = dynamic_cast<ParenExpr *>(expr))
+        expr = paren->expr;
+
+    if(!isElementwise(expr)) {
+        Value *operand = operands[expr];
+        if(expr->getType() != ValueType::ARRAY)
+            return operand;
+
+        // nested arrays are walked as one flat run of integers
+        LoadInst *elem = Builder->CreateLoad(Builder->getInt64Ty(), Builder->CreateInBoundsGEP(Builder->getInt64Ty(), operand, i));
+        elem->setMetadata(LLVMContext::MD_access_group, group);
+        return elem;
+    }
+
+    if(auto *add = dynamic_cast<AddExpr *>(expr)) {
+        Value *lhs = emitElement(add->LHS, i, operands, group), *rhs = emitElement(add->RHS, i, operands, group);
+        return (add->OP == TOKEN::PLUS? Builder->CreateNSWAdd(lhs, rhs, "addtmp") : Builder->CreateNSWSub(lhs, rhs, "addtmp"));
+    }
+
+    auto *term = dynamic_cast<TermExpr *>(expr);
+    Value *lhs = emitElement(term->LHS, i, operands, group), *rhs = emitElement(term->RHS, i, operands, group);
+    return (term->OP == TOKEN::MUL? Builder->CreateNSWMul(lhs, rhs, "multmp") : Builder->CreateSDiv(lhs, rhs, "divtmp"));
+}
+
+// The whole expression tree becomes one loop that reads every operand at index i
+// and writes dest at index i, so no intermediate array is ever stored.
+// A sized destination is either one of the operands or disjoint from all of them,
+// which makes the iterations independent: the loop is then marked parallel and the
+// vectorizer needs no overlap checks. An unsized parameter may point anywhere.
+static bool emitElementwise(Expr *value, Value *dest, bool sized_dest, CodeVisitor& code_vis) {
+    DenseMap<Expr *, Value *> operands;
+    if(!collectOperands(value, operands, code_vis))
+        return false;
+
+    MDNode *group = nullptr, *loopID = nullptr;
+    if(sized_dest) {
+        group = MDNode::getDistinct(*LLCTX, {});
+        MDNode *parallel = MDNode::get(*LLCTX, { MDString::get(*LLCTX, "llvm.loop.parallel_accesses"), group });
+        loopID = MDNode::getDistinct(*LLCTX, { nullptr, parallel });
+        loopID->replaceOperandWith(0, loopID);
+    }
+
+    Value *n = Builder->getInt64(elementCount(value->getType()));
+    emitCountedLoop(n, Builder->getInt64(0), [&](Value *i, Value *acc) {
+        Value *elem = emitElement(value, i, operands, group);
+        
+        StoreInst *store = Builder->CreateStore(elem, Builder->CreateInBoundsGEP(Builder->getInt64Ty(), dest, i));
+        store->setMetadata(LLVMContext::MD_access_group, group);
+        
+        return acc;
+    }, loopID);
+
+    return true;
+}
+
+// Writes an array-valued expression straight into dest instead of going through an
+// SSA aggregate: literals are stored element by element (or memset when all zero),
+// arithmetic is fused into one loop, anything with an address is memcpy'd.
+static bool emitArrayInto(Expr *value, Value *dest, CodeVisitor& code_vis, bool sized_dest = true) {
+    while(auto *paren = dynamic_cast<ParenExpr *>(value))
+        value = paren->expr;
+
+    Type *arr_type = CodeVisitor::convert(value->getType());
+    const DataLayout& DL = TheModule->getDataLayout();
+
+    if(isElementwise(value))
+        return emitElementwise(value, dest, sized_dest, code_vis);
+    
+    if(auto *array = dynamic_cast<ArrayExpr *>(value)) {
+        // past a few cache lines a constant literal is cheaper to copy out of .rodata
+        // than to rebuild with one store per element
+        if(DL.getTypeAllocSize(arr_type) > 64 && isConstantExpr(array)) {
+            Constant *init = constantValue(array, code_vis);
+            
+            if(!init->isNullValue()) {
+                GlobalVariable *src = CreateGlobal(arr_type, true, init, "arrconst", GlobalValue::PrivateLinkage);
+                Builder->CreateMemCpy(dest, MaybeAlign(), src, MaybeAlign(), DL.getTypeAllocSize(arr_type));
+                return true;
+            }
+        }
+        
+        vector<Value *> path{ ConstantInt::get(*LLCTX, APInt(64, 0)) };
+        vector<pair<vector<Value *>, Expr *>> leaves;
+        collectLeaves(*array, path, leaves);
+
+        // every element is read before the first store, so 'a = [a[1], a[0]]' still works
+        vector<Value *> values;
+        bool zero = true;
+        for(auto& [idx, elem]: leaves) {
+            Value *elemV = elem->accept(code_vis);
+            if(!elemV)
+                return false;
+
+            auto *C = dyn_cast<Constant>(elemV);
+            zero &= (C && C->isNullValue());
+            values.push_back(elemV);
+        }
+
+        if(zero) {
+            Builder->CreateMemSet(dest, Builder->getInt8(0), DL.getTypeAllocSize(arr_type), MaybeAlign());
+            return true;
+        }
+        
+        for(size_t i = 0, e = leaves.size(); i < e; ++i)
+            Builder->CreateStore(values[i], Builder->CreateInBoundsGEP(arr_type, dest, leaves[i].first));
+
+        return true;
+    }
+
+    AddrVisitor addr_vis;
+    if(Value *src = value->accept(addr_vis)) {
+        Builder->CreateMemCpy(dest, MaybeAlign(), src, MaybeAlign(), DL.getTypeAllocSize(arr_type));
+        return true;
+    }
+
+    // calls returning an array are the only aggregates left
+    Value *arrV = value->accept(code_vis);
+    if(!arrV)
+        return false;
+
+    Builder->CreateStore(arrV, dest);
+    return true;
+}
+
+// Runtime-sized arrays come zeroed from the runtime pool and go back to it when their block ends.
+static Value *allocHeapArray(WarStmt& war, CodeVisitor& code_vis) {
+    Value *count = war.size->accept(code_vis);
+    if(!count)
+        return nullptr;
+
+    Type *elemType = CodeVisitor::convert(war.type->getSub());
+    Value *bytes = Builder->CreateNSWMul(count, Builder->getInt64(TheModule->getDataLayout().getTypeAllocSize(elemType)),
+                                         war.name + ".bytes");
+    Value *arr = Builder->CreateCall(AllocF, { bytes }, war.name);
+
+    cleanups.back().push_back({arr, bytes});
+    
+    return arr;
+}
+
 Value *CodeVisitor::visit(WarStmt& war) {
+    Type *warType = convert(war.type);
+    bool constInit = war.value && isConstantExpr(war.value);
+    Value *warAddr;
+    
+    if(war.sym->isGlobal() && (warType->isArrayTy() || war.sym->isShared())) {
+        // a constant initializer costs nothing at startup, anything else is stored by main
+        Constant *init = (constInit? constantValue(war.value, *this) : Constant::getNullValue(warType));
+        GlobalVariable *GV = CreateGlobal(warType, war.sym->isConstant() && constInit, init, war.name);
+        
+        globals[war.sym->getSlot()] = GV;
+        if(constInit)
+            return ConstantInt::get(*LLCTX, APInt(64, 0));
+
+        warAddr = GV;
+    }
+    else if(war.sym->isConstant() && constInit && war.type == ValueType::ARRAY) {
+        // an immutable table is only ever read, so every call can share one copy in .rodata
+        GlobalVariable *GV = CreateGlobal(warType, true, constantValue(war.value, *this),
+                                          Builder->GetInsertBlock()->getParent()->getName().str() + "." + war.name);
+        
+        slots[war.sym->getSlot()] = GV;
+        return ConstantInt::get(*LLCTX, APInt(64, 0));
+    }
+    else {
+        warAddr = CreateEntryBlockAlloca(warType, war.name);
+        (war.sym->isGlobal()? globals : slots)[war.sym->getSlot()] = warAddr;
+    }
+
+    if(war.size) {
+        Value *arr = allocHeapArray(war, *this);
+        if(!arr)
+            return nullptr;
+
+        Builder->CreateStore(arr, warAddr);
+        return ConstantInt::get(*LLCTX, APInt(64, 0));
+    }
+    
+    if(war.type == ValueType::ARRAY)
+        return (emitArrayInto(war.value, warAddr, *this)? ConstantInt::get(*LLCTX, APInt(64, 0)) : nullptr);
+    
     Value *warValue = war.value->accept(*this);
     if(!warValue)
         return nullptr;
     
-    Type *warType = convert(war.type);
-    AllocaInst *warAddr = Builder->CreateAlloca(warType, nullptr, war.name);
-
     Builder->CreateStore(warValue, warAddr);
-
-    add_symbol(make_shared<LLSym>(war.name, warType, warAddr));
     
     return ConstantInt::get(*LLCTX, APInt(64, 0));
 }
 
+// attributes of a user function from what the Analyzer proved about it
+static void addFacts(Function *func, const FuncFacts& facts) {
+    // nothing in the language unwinds
+    func->addFnAttr(Attribute::NoUnwind);
+    if(facts.willreturn)
+        func->addFnAttr(Attribute::WillReturn);
+    if(facts.norecurse)
+        func->addFnAttr(Attribute::NoRecurse);
+
+    // the memory it may touch, then whether it only reads it
+    if(!facts.argmem && !facts.globals && !facts.inaccessible)
+        func->setDoesNotAccessMemory();
+    else {
+        if(!facts.globals && !facts.inaccessible)
+            func->setOnlyAccessesArgMemory();
+        else if(!facts.globals && !facts.argmem)
+            func->setOnlyAccessesInaccessibleMemory();
+        else if(!facts.globals)
+            func->setOnlyAccessesInaccessibleMemOrArgMem();
+
+        if(!facts.writes)
+            func->setOnlyReadsMemory();
+    }
+
+    // arrays are passed by address, and nothing in the language keeps an address
+    for(auto& Arg: func->args()) {
+        if(!Arg.getType()->isPointerTy())
+            continue;
+
+        unsigned i = Arg.getArgNo();
+        Arg.addAttr(Attribute::NoCapture);
+        if(i < 32 && (facts.readonly >> i & 1))
+            Arg.addAttr(Attribute::ReadOnly);
+        if(i < 32 && (facts.noalias >> i & 1))
+            Arg.addAttr(Attribute::NoAlias);
+    }
+}
+
+// Direct-mapped cache in front of a memoized function: an entry holds the arguments,
+// the result and a filled flag, and a colliding call simply takes the entry over.
+static constexpr unsigned MEMO_BITS = 12;
+
+static void emitMemoCache(Function *func, Function *body) {
+    Type *intTy = Builder->getInt64Ty();
+    size_t nargs = func->arg_size(), stride = nargs + 2;
+
+    llvm::ArrayType *cacheTy = llvm::ArrayType::get(intTy, stride << MEMO_BITS);
+    GlobalVariable *cache = CreateGlobal(cacheTy, false, ConstantAggregateZero::get(cacheTy), func->getName().str() + ".cache");
+
+    BasicBlock *prevbb = Builder->GetInsertBlock();
+    BasicBlock *entry = BasicBlock::Create(*LLCTX, "entry", func);
+    BasicBlock *HitBB = BasicBlock::Create(*LLCTX, "hit", func);
+    BasicBlock *MissBB = BasicBlock::Create(*LLCTX, "miss", func);
+
+    Builder->SetInsertPoint(entry);
+
+    // multiplicative hash of the arguments, its top bits pick the entry
+    Value *hash = Builder->getInt64(0);
+    for(auto& Arg: func->args())
+        hash = Builder->CreateMul(Builder->CreateXor(hash, &Arg), Builder->getInt64(0x9E3779B97F4A7C15ull));
+
+    Value *index = Builder->CreateNUWMul(Builder->CreateLShr(hash, 64 - MEMO_BITS), Builder->getInt64(stride));
+    Value *slot = Builder->CreateInBoundsGEP(intTy, cache, index, "memo.entry");
+    auto field = [&](size_t i) { return Builder->CreateConstInBoundsGEP1_64(intTy, slot, i); };
+
+    Value *hit = Builder->CreateICmpNE(Builder->CreateLoad(intTy, field(nargs + 1)), Builder->getInt64(0));
+    for(auto& Arg: func->args())
+        hit = Builder->CreateAnd(hit, Builder->CreateICmpEQ(Builder->CreateLoad(intTy, field(Arg.getArgNo())), &Arg));
+
+    Builder->CreateCondBr(hit, HitBB, MissBB);
+
+    Builder->SetInsertPoint(HitBB);
+    Builder->CreateRet(Builder->CreateLoad(intTy, field(nargs), "memo.value"));
+
+    Builder->SetInsertPoint(MissBB);
+
+    std::vector<Value *> args;
+    for(auto& Arg: func->args())
+        args.push_back(&Arg);
+    CallInst *result = Builder->CreateCall(body, args, "calltmp");
+    result->setCallingConv(body->getCallingConv());
+
+    // recursive calls may have taken the entry in the meantime, so all of it is rewritten
+    for(auto& Arg: func->args())
+        Builder->CreateStore(&Arg, field(Arg.getArgNo()));
+    Builder->CreateStore(result, field(nargs));
+    Builder->CreateStore(Builder->getInt64(1), field(nargs + 1));
+
+    Builder->CreateRet(result);
+
+    Builder->SetInsertPoint(prevbb);
+}
+
 Function *CodeVisitor::visit(TrenStmt& tren) {
     size_t n = tren.args.size();
     
@@ -132,9 +619,41 @@ Function *CodeVisitor::visit(TrenStmt& tren) {
 
     Type *funcType = convert(tren.retType);
     FunctionType *ft = FunctionType::get(funcType, Vargs, false);
-    Function *func = Function::Create(ft, Function::ExternalLinkage, tren.name, TheModule.get());
-    
-    enter_scope();
+    // only exported functions keep a symbol and the C calling convention, the rest are
+    // free for the optimizer to inline, drop or call however is cheapest
+    auto linkage = (tren.exported? Function::ExternalLinkage : Function::InternalLinkage);
+    Function *func = Function::Create(ft, linkage, tren.name, TheModule.get());
+    if(tren.exported && func->getName() != tren.name) {
+        LogCodeError("exported function '" + tren.name + "' clashes with another symbol");
+        return nullptr;
+    }
+
+    func->setCallingConv(tren.exported? CallingConv::C : CallingConv::Fast);
+    functions[tren.sym->getSlot()] = func;
+    addFacts(func, tren.facts);
+
+    // calls, recursive ones included, go through the cache and only misses reach the body
+    if(tren.memoize) {
+        Function *body = Function::Create(ft, Function::InternalLinkage, tren.name + ".body", TheModule.get());
+        body->setCallingConv(CallingConv::Fast);
+        addFacts(body, tren.facts);
+        for(auto& Arg: func->args())
+            Arg.setName(tren.args[Arg.getArgNo()].first);
+
+        emitMemoCache(func, body);
+        func = body;
+    }
+
+    vector<Value *> outer_slots = std::move(slots);
+    slots.assign(tren.nslots, nullptr);
+
+    auto outer_cleanups = std::move(cleanups);
+    cleanups.clear();
+    enterBlock();
+
+    // a function declared inside a fightclub body is not part of the body
+    Capture outer_capture = std::move(capture);
+    capture = Capture();
 
     BasicBlock *prevbb = Builder->GetInsertBlock();
     
@@ -142,52 +661,162 @@ Function *CodeVisitor::visit(TrenStmt& tren) {
 
     Builder->SetInsertPoint(entry);
     
+    // arguments take the first slots of the function
     size_t I = 0;
     for(auto& Arg: func->args()) {
         string argName = tren.args[I].first;
         Arg.setName(argName);
 
-        AllocaInst *arg_addr = Builder->CreateAlloca(Arg.getType(), nullptr);
+        AllocaInst *arg_addr = CreateEntryBlockAlloca(Arg.getType(), argName + ".addr");
 
         Builder->CreateStore(&Arg, arg_addr);
 
-        add_symbol(make_shared<LLSym>(argName, Vargs[I], arg_addr));
+        slots[I] = arg_addr;
         
         ++I;
     }
 
+    BasicBlock *outer_recurse = recurseBB;
+    recurseBB = BasicBlock::Create(*LLCTX, "tailrecurse", func);
+    Builder->CreateBr(recurseBB);
+    Builder->SetInsertPoint(recurseBB);
+
     Value *BodyV = tren.func_body->accept(*this);
     if(!BodyV)
         return nullptr;
 
-    exit_scope();
+    exitBlock();
+    
+    // falling off the end of a function returns zero
+    if(!Builder->GetInsertBlock()->getTerminator())
+        Builder->CreateRet(Constant::getNullValue(funcType));
+    
+    slots = std::move(outer_slots);
+    cleanups = std::move(outer_cleanups);
+    capture = std::move(outer_capture);
+    recurseBB = outer_recurse;
     
-    verifyFunction(*func);
+    if(verifyFunction(*func, &errs())) {
+        LogCodeError("invalid function '" + tren.name + "'");
+        return nullptr;
+    }
 
     Builder->SetInsertPoint(prevbb);
     
     return func;
 }
 
+// Whether the call hands the callee an address in the caller's frame. Arrays going to a
+// sized parameter are copied, the others are passed by address: only globals and arrays
+// the caller got by address itself live outside the frame, a sized array parameter is
+// kept in the caller's own alloca just like a local.
+static bool borrowsFrame(CallExpr& call, Function *caller) {
+    for(size_t i = 0; i < call.args.size(); ++i) {
+        Expr *arg = call.args[i];
+        if(arg->getType() != ValueType::ARRAY || call.sym->getArgs()[i].second->size())
+            continue;
+
+        while(auto *paren = dynamic_cast<ParenExpr *>(arg))
+            arg = paren->expr;
+
+        auto *id = dynamic_cast<IDExpr *>(arg);
+        if(!id)
+            return true;
+        if(id->sym->isGlobal())
+            continue;
+
+        int slot = id->sym->getSlot();
+        if(slot >= (int)caller->arg_size() || !caller->getArg(slot)->getType()->isPointerTy())
+            return true;
+    }
+
+    return false;
+}
+
 Value *CodeVisitor::visit(RetStmt& ret) {
     Function *retFunc = Builder->GetInsertBlock()->getParent();
 
+    Expr *tail = ret.expr;
+    while(auto *paren = dynamic_cast<ParenExpr *>(tail))
+        tail = paren->expr;
+
+    // nothing may be left to free after a call in tail position
+    auto *tailCall = dynamic_cast<CallExpr *>(tail);
+    for(auto& frame: cleanups)
+        if(!frame.empty())
+            tailCall = nullptr;
+
+    bool borrows = tailCall && borrowsFrame(*tailCall, retFunc);
+
+    // self recursion becomes a loop: new arguments go to the argument slots, and the
+    // body starts over. An address in the frame would point at locals the next round
+    // overwrites.
+    if(tailCall && !borrows && functions[tailCall->sym->getSlot()] == retFunc) {
+        std::vector<Value *> args;
+        if(!emitArgs(*tailCall, retFunc, *this, args))
+            return nullptr;
+
+        for(size_t i = 0; i < args.size(); ++i)
+            Builder->CreateStore(args[i], slots[i]);
+
+        Builder->CreateBr(recurseBB);
+
+        return ConstantInt::get(*LLCTX, APInt(64, 0));
+    }
+
     Value *retExpr = ret.expr->accept(*this);
     if(!retExpr)
         return nullptr;
 
-    if(retFunc->getFunctionType()->isPointerTy()) {
-        AllocaInst *retAddr = Builder->CreateAlloca(retFunc->getFunctionType(), nullptr, "ret");
-        Builder->CreateStore(retExpr, retAddr);
-
-        retExpr = retAddr;
+    // a tail callee may not touch the caller's frame; musttail is only allowed between
+    // matching signatures, tail still lets the backend turn the others into jumps
+    if(auto *CI = dyn_cast<CallInst>(retExpr); CI && tailCall && !borrows) {
+        bool same = (CI->getFunctionType() == retFunc->getFunctionType()
+                     && CI->getCallingConv() == retFunc->getCallingConv());
+        CI->setTailCallKind(same? CallInst::TCK_MustTail : CallInst::TCK_Tail);
     }
+
+    // the value is computed, every block of the function is left at once
+    for(auto it = cleanups.rbegin(); it != cleanups.rend(); ++it)
+        emitFrees(*it);
     
     Builder->CreateRet(retExpr);
     
     return ConstantInt::get(*LLCTX, APInt(64, 0));
 }
 
+// __builtin_expect-strength weights for 'likely'/'unlikely'
+static MDNode *branchWeights(const Hints& hints) {
+    if(!hints.likely)
+        return nullptr;
+
+    MDBuilder MDB(*LLCTX);
+    return (hints.likely > 0? MDB.createBranchWeights(2000, 1) : MDB.createBranchWeights(1, 2000));
+}
+
+static MDNode *loopMetadata(const Hints& hints) {
+    if(!hints.unroll && !hints.vectorize)
+        return nullptr;
+
+    auto hint = [](StringRef name, Constant *value) -> Metadata * {
+        return MDNode::get(*LLCTX, { MDString::get(*LLCTX, name), ConstantAsMetadata::get(value) });
+    };
+    
+    SmallVector<Metadata *, 4> MDs{ nullptr }; // operand 0 is the loop id itself
+
+    if(hints.unroll)
+        MDs.push_back(hint("llvm.loop.unroll.count", Builder->getInt32(hints.unroll)));
+    if(hints.vectorize) {
+        MDs.push_back(hint("llvm.loop.vectorize.enable", Builder->getTrue()));
+        MDs.push_back(hint("llvm.loop.vectorize.width", Builder->getInt32(hints.vectorize)));
+    }
+
+    MDNode *loopID = MDNode::getDistinct(*LLCTX, MDs);
+    loopID->replaceOperandWith(0, loopID);
+    
+    return loopID;
+}
+
 Value *CodeVisitor::visit(IfStmt& ifstmt) {
     Function *TheFunction = Builder->GetInsertBlock()->getParent();
 
@@ -200,54 +829,234 @@ Value *CodeVisitor::visit(IfStmt& ifstmt) {
     BasicBlock *BodyBB = BasicBlock::Create(*LLCTX, "ifbody", TheFunction);
     BasicBlock *nextBB = BasicBlock::Create(*LLCTX, "next", TheFunction);
 
-    Builder->CreateCondBr(CondV, BodyBB, nextBB);
+    Builder->CreateCondBr(CondV, BodyBB, nextBB, branchWeights(ifstmt.hints));
 
     Builder->SetInsertPoint(BodyBB);
-    
+
+    enterBlock();
     Value *BodyV = ifstmt.Body->accept(*this);
     if(!BodyV)
         return nullptr;
+    exitBlock();
 
-    Builder->CreateBr(nextBB);
+    if(!Builder->GetInsertBlock()->getTerminator())
+        Builder->CreateBr(nextBB);
 
     Builder->SetInsertPoint(nextBB);
 
     return ConstantInt::get(*LLCTX, APInt(64, 0));
 }
 
-
+// Lowered as a rotated loop: the condition guards entry once, then is re-evaluated
+// in the latch at the bottom of every iteration, which is the shape LLVM's loop passes expect.
 Value *CodeVisitor::visit(AliveStmt& alive) {
     Function *TheFunction = Builder->GetInsertBlock()->getParent();
 
+    BasicBlock *BodyBB = BasicBlock::Create(*LLCTX, "alivebody", TheFunction);
+    BasicBlock *LatchBB = BasicBlock::Create(*LLCTX, "alivelatch", TheFunction);
+    BasicBlock *NextBB = BasicBlock::Create(*LLCTX, "next", TheFunction);
+
     Value *CondV = alive.Cond->accept(*this);
     if(!CondV)
         return nullptr;
 
-    BasicBlock *CondBB = BasicBlock::Create(*LLCTX, "alivecondblock", TheFunction);
-    BasicBlock *BodyBB = BasicBlock::Create(*LLCTX, "alivebody", TheFunction);    
-    BasicBlock *NextBB = BasicBlock::Create(*LLCTX, "next", TheFunction);
+    CondV = Builder->CreateICmpNE(CondV, ConstantInt::get(*LLCTX, APInt(64, 0)), "aliveguard");
+    Builder->CreateCondBr(CondV, BodyBB, NextBB);
 
-    Builder->CreateBr(CondBB);
-    
-    Builder->SetInsertPoint(CondBB);
+    Builder->SetInsertPoint(BodyBB);
+
+    enterBlock();
+    Value *BodyV = alive.Body->accept(*this);
+    if(!BodyV)
+        return nullptr;
+    exitBlock();
+
+    if(!Builder->GetInsertBlock()->getTerminator())
+        Builder->CreateBr(LatchBB);
+
+    Builder->SetInsertPoint(LatchBB);
+
+    CondV = alive.Cond->accept(*this);
+    if(!CondV)
+        return nullptr;
 
     CondV = Builder->CreateICmpNE(CondV, ConstantInt::get(*LLCTX, APInt(64, 0)), "alivecond");
+    BranchInst *backedge = Builder->CreateCondBr(CondV, BodyBB, NextBB);
 
-    Builder->CreateCondBr(CondV, BodyBB, NextBB);
+    if(MDNode *loopID = loopMetadata(alive.hints))
+        backedge->setMetadata(LLVMContext::MD_loop, loopID);
+
+    Builder->SetInsertPoint(NextBB);
+
+    return ConstantInt::get(*LLCTX, APInt(64, 0));
+}
+
+
+// Canonical counted loop: the induction variable is a phi stepped with 'add nsw',
+// so SCEV sees the trip count End - Start without having to prove no overflow.
+Value *CodeVisitor::visit(ForStmt& forstmt) {
+    Function *TheFunction = Builder->GetInsertBlock()->getParent();
+
+    Value *StartV = forstmt.Start->accept(*this);
+    Value *EndV = forstmt.End->accept(*this);
+    if(!StartV || !EndV)
+        return nullptr;
+
+    AllocaInst *varAddr = CreateEntryBlockAlloca(Type::getInt64Ty(*LLCTX), forstmt.name);
+    slots[forstmt.sym->getSlot()] = varAddr;
+
+    BasicBlock *PreheaderBB = Builder->GetInsertBlock();
+    BasicBlock *BodyBB = BasicBlock::Create(*LLCTX, "forbody", TheFunction);
+    BasicBlock *LatchBB = BasicBlock::Create(*LLCTX, "forlatch", TheFunction);
+    BasicBlock *NextBB = BasicBlock::Create(*LLCTX, "next", TheFunction);
+
+    Builder->CreateCondBr(Builder->CreateICmpSLT(StartV, EndV, "forguard"), BodyBB, NextBB);
 
     Builder->SetInsertPoint(BodyBB);
+    PHINode *IV = Builder->CreatePHI(Type::getInt64Ty(*LLCTX), 2, forstmt.name);
+    IV->addIncoming(StartV, PreheaderBB);
+    Builder->CreateStore(IV, varAddr);
 
-    Value *BodyV = alive.Body->accept(*this);
+    enterBlock();
+    Value *BodyV = forstmt.Body->accept(*this);
     if(!BodyV)
         return nullptr;
+    exitBlock();
 
-    Builder->CreateBr(CondBB);
+    if(!Builder->GetInsertBlock()->getTerminator())
+        Builder->CreateBr(LatchBB);
+
+    Builder->SetInsertPoint(LatchBB);
+    
+    Value *NextV = Builder->CreateNSWAdd(IV, ConstantInt::get(*LLCTX, APInt(64, 1)), "fornext");
+    IV->addIncoming(NextV, LatchBB);
+    
+    BranchInst *backedge = Builder->CreateCondBr(Builder->CreateICmpSLT(NextV, EndV, "forcond"), BodyBB, NextBB);
+    if(MDNode *loopID = loopMetadata(forstmt.hints))
+        backedge->setMetadata(LLVMContext::MD_loop, loopID);
 
     Builder->SetInsertPoint(NextBB);
 
     return ConstantInt::get(*LLCTX, APInt(64, 0));
 }
 
+// The body is outlined into <function>.fightclub(ctx, begin, end), which the runtime's
+// work-stealing pool calls on chunks of the range. Each call accumulates reductions
+// privately and folds them into the variable with a single atomic at the end.
+Value *CodeVisitor::visit(FightStmt& fight) {
+    Value *StartV = fight.Start->accept(*this);
+    Value *EndV = fight.End->accept(*this);
+    if(!StartV || !EndV)
+        return nullptr;
+
+    Type *ptrTy = PointerType::get(*LLCTX, 0), *intTy = Type::getInt64Ty(*LLCTX);
+    BasicBlock *prevbb = Builder->GetInsertBlock();
+
+    FunctionType *body_ft = FunctionType::get(Type::getVoidTy(*LLCTX), { ptrTy, intTy, intTy }, false);
+    Function *body = Function::Create(body_ft, Function::InternalLinkage,
+                                      prevbb->getParent()->getName() + ".fightclub", TheModule.get());
+    body->addFnAttr(Attribute::NoUnwind);
+    
+    Value *Begin = body->getArg(1), *End = body->getArg(2);
+    body->getArg(0)->setName("ctx");
+    Begin->setName("begin");
+    End->setName("end");
+
+    size_t nslots = slots.size();
+    vector<Value *> outer_slots = std::move(slots);
+    slots.assign(nslots, nullptr);
+    
+    auto outer_cleanups = std::move(cleanups);
+    cleanups.clear();
+    
+    capture.func = body;
+    capture.ctx = body->getArg(0);
+
+    BasicBlock *entry = BasicBlock::Create(*LLCTX, "entry", body);
+    Builder->SetInsertPoint(entry);
+
+    for(auto& red: fight.reductions) {
+        int64_t identity = (red.kind == Reduction::SUM? 0 : red.kind == Reduction::MIN? INT64_MAX : INT64_MIN);
+        
+        AllocaInst *acc = CreateEntryBlockAlloca(intTy, red.sym->getName() + ".private");
+        Builder->CreateStore(Builder->getInt64(identity), acc);
+        capture.privates[red.sym] = acc;
+    }
+
+    AllocaInst *varAddr = CreateEntryBlockAlloca(intTy, fight.name);
+    slots[fight.sym->getSlot()] = varAddr;
+
+    BasicBlock *BodyBB = BasicBlock::Create(*LLCTX, "fightbody", body);
+    BasicBlock *LatchBB = BasicBlock::Create(*LLCTX, "fightlatch", body);
+    BasicBlock *ExitBB = BasicBlock::Create(*LLCTX, "exit", body);
+
+    Builder->CreateCondBr(Builder->CreateICmpSLT(Begin, End, "fightguard"), BodyBB, ExitBB);
+
+    Builder->SetInsertPoint(BodyBB);
+    PHINode *IV = Builder->CreatePHI(intTy, 2, fight.name);
+    IV->addIncoming(Begin, entry);
+    Builder->CreateStore(IV, varAddr);
+
+    enterBlock();
+    Value *BodyV = fight.Body->accept(*this);
+    if(!BodyV)
+        return nullptr;
+    exitBlock();
+
+    if(!Builder->GetInsertBlock()->getTerminator())
+        Builder->CreateBr(LatchBB);
+
+    Builder->SetInsertPoint(LatchBB);
+    
+    Value *NextV = Builder->CreateNSWAdd(IV, Builder->getInt64(1), "fightnext");
+    IV->addIncoming(NextV, LatchBB);
+    
+    BranchInst *backedge = Builder->CreateCondBr(Builder->CreateICmpSLT(NextV, End, "fightcond"), BodyBB, ExitBB);
+    if(MDNode *loopID = loopMetadata(fight.hints))
+        backedge->setMetadata(LLVMContext::MD_loop, loopID);
+
+    Builder->SetInsertPoint(ExitBB);
+    
+    // the pool joins before gars_parallel_for returns, so relaxed atomics are enough
+    for(auto& red: fight.reductions) {
+        Value *shared = (red.sym->isGlobal()? globals[red.sym->getSlot()] : captureSlot(red.sym->getSlot()));
+        Value *partial = Builder->CreateLoad(intTy, capture.privates[red.sym], red.sym->getName() + ".partial");
+        
+        AtomicRMWInst::BinOp op = (red.kind == Reduction::SUM? AtomicRMWInst::Add :
+                                   red.kind == Reduction::MIN? AtomicRMWInst::Min : AtomicRMWInst::Max);
+        Builder->CreateAtomicRMW(op, shared, partial, MaybeAlign(8), AtomicOrdering::Monotonic);
+    }
+    
+    Builder->CreateRetVoid();
+
+    vector<int> used = std::move(capture.used);
+    capture = Capture();
+    slots = std::move(outer_slots);
+    cleanups = std::move(outer_cleanups);
+    
+    if(verifyFunction(*body, &errs())) {
+        LogCodeError("invalid fightclub body");
+        return nullptr;
+    }
+
+    Builder->SetInsertPoint(prevbb);
+
+    // only the variables the body uses are passed, the others can stay in registers
+    Value *ctx = Constant::getNullValue(ptrTy);
+    if(!used.empty()) {
+        llvm::ArrayType *ctxTy = llvm::ArrayType::get(ptrTy, nslots);
+        AllocaInst *ctxAddr = CreateEntryBlockAlloca(ctxTy, "fight.ctx");
+        
+        for(int slot: used)
+            Builder->CreateStore(slots[slot], Builder->CreateConstInBoundsGEP2_64(ctxTy, ctxAddr, 0, slot));
+
+        ctx = ctxAddr;
+    }
+
+    Builder->CreateCall(ParallelF, { body, ctx, StartV, EndV });
+
+    return ConstantInt::get(*LLCTX, APInt(64, 0));
+}
 
 Value *CodeVisitor::visit(HighExpr& hexpr) {
     Value *Vexpr = hexpr.expr->accept(*this);
@@ -258,20 +1067,25 @@ Value *CodeVisitor::visit(HighExpr& hexpr) {
 }
 
 Value *CodeVisitor::visit(ParenStmts& paren) {
-    enter_scope();
-
+    enterBlock();
     for(size_t i = 0, e = paren.stmts.size(); i < e; ++i) {
         Value *stmt = paren.stmts[i]->accept(*this);
         if(!stmt)
             return nullptr;
     }
+    exitBlock();
 
-    exit_scope();
     return ConstantInt::get(*LLCTX, APInt(64, 0));
 }
 
 
 Value *CodeVisitor::visit(AssignExpr& assign) {
+    // arrays are assigned in place, the value of the expression is the address
+    if(assign.type == ValueType::ARRAY) {
+        AddrVisitor addr_vis;
+        return assign.accept(addr_vis);
+    }
+    
     AddrVisitor *addr_vis = new AddrVisitor();
     
     Value *lhs = assign.LHS->accept(*addr_vis);
@@ -285,6 +1099,17 @@ Value *CodeVisitor::visit(AssignExpr& assign) {
     return rhs;
 }
 
+// Only reached when an array value is needed as an SSA aggregate (e.g. returned);
+// declarations, assignments and call arguments build literals and arithmetic in place.
+static Value *loadArray(Expr& expr) {
+    AddrVisitor addr_vis;
+    Value *arr_addr = expr.accept(addr_vis);
+    if(!arr_addr)
+        return nullptr;
+    
+    return Builder->CreateLoad(CodeVisitor::convert(expr.getType()), arr_addr, "arrloadtemp");
+}
+
 Value *CodeVisitor::visit(BoolExpr& boolexpr) {
     Value *lhs = boolexpr.LHS->accept(*this), *rhs = boolexpr.RHS->accept(*this);
     
@@ -308,14 +1133,17 @@ Value *CodeVisitor::visit(BoolExpr& boolexpr) {
 
 
 Value *CodeVisitor::visit(AddExpr& add) {
+    if(add.type == ValueType::ARRAY)
+        return loadArray(add);
+    
     Value *lhs = add.LHS->accept(*this), *rhs = add.RHS->accept(*this);
     
     if(!lhs || !rhs)
         return nullptr;
 
     switch(add.OP) {
-    case TOKEN::PLUS: return Builder->CreateAdd(lhs, rhs, "addtmp");
-    case TOKEN::MINUS: return Builder->CreateSub(lhs, rhs, "addtmp");
+    case TOKEN::PLUS: return Builder->CreateNSWAdd(lhs, rhs, "addtmp");
+    case TOKEN::MINUS: return Builder->CreateNSWSub(lhs, rhs, "addtmp");
     default: return LogCodeError("undefined operator for bool");
     }
 
@@ -323,13 +1151,16 @@ Value *CodeVisitor::visit(AddExpr& add) {
 }
 
 Value *CodeVisitor::visit(TermExpr& term) {
+    if(term.type == ValueType::ARRAY)
+        return loadArray(term);
+    
     Value *lhs = term.LHS->accept(*this), *rhs = term.RHS->accept(*this);
     
     if(!lhs || !rhs)
         return nullptr;
 
     switch(term.OP) {
-    case TOKEN::MUL: return Builder->CreateMul(lhs, rhs, "addtmp");
+    case TOKEN::MUL: return Builder->CreateNSWMul(lhs, rhs, "addtmp");
     case TOKEN::DIV: return Builder->CreateSDiv(lhs, rhs, "addtmp");
     default: return LogCodeError("undefined operator for bool");
     }
@@ -338,34 +1169,160 @@ Value *CodeVisitor::visit(TermExpr& term) {
 }
 
 Value *CodeVisitor::visit(IDExpr& idexp) {
-    shared_ptr<LLSym> sym = find_symbol(idexp.name);
-    if(!sym)
-        return LogCodeError("not found this id");
+    return Builder->CreateLoad(convert(idexp.sym->getType()), symbolAddr(idexp.sym), "idexpr");
+}
+
+// Counted loop over [0, n) carrying one accumulator, in the rotated shape the loop
+// vectorizer expects. step must stay in the block it is given.
+static Value *emitCountedLoop(Value *n, Value *init, function_ref<Value *(Value *, Value *)> step, MDNode *loopID) {
+    Function *TheFunction = Builder->GetInsertBlock()->getParent();
+    
+    BasicBlock *PreheaderBB = Builder->GetInsertBlock();
+    BasicBlock *BodyBB = BasicBlock::Create(*LLCTX, "body", TheFunction);
+    BasicBlock *ExitBB = BasicBlock::Create(*LLCTX, "exit", TheFunction);
+
+    Builder->CreateCondBr(Builder->CreateICmpSGT(n, Builder->getInt64(0)), BodyBB, ExitBB);
+
+    Builder->SetInsertPoint(BodyBB);
+    PHINode *I = Builder->CreatePHI(Builder->getInt64Ty(), 2, "i");
+    PHINode *Acc = Builder->CreatePHI(init->getType(), 2, "acc");
+    I->addIncoming(Builder->getInt64(0), PreheaderBB);
+    Acc->addIncoming(init, PreheaderBB);
+
+    Value *NextAcc = step(I, Acc);
+    Value *NextI = Builder->CreateNSWAdd(I, Builder->getInt64(1), "i.next");
+    I->addIncoming(NextI, BodyBB);
+    Acc->addIncoming(NextAcc, BodyBB);
     
-    return Builder->CreateLoad(sym->addr->getAllocatedType(), sym->addr, "idexpr");
+    BranchInst *backedge = Builder->CreateCondBr(Builder->CreateICmpSLT(NextI, n), BodyBB, ExitBB);
+    if(loopID)
+        backedge->setMetadata(LLVMContext::MD_loop, loopID);
+
+    Builder->SetInsertPoint(ExitBB);
+    PHINode *Result = Builder->CreatePHI(init->getType(), 2, "result");
+    Result->addIncoming(init, PreheaderBB);
+    Result->addIncoming(NextAcc, BodyBB);
+
+    return Result;
 }
 
-Value *CodeVisitor::visit(CallExpr& call) {
-    Function *func = TheModule->getFunction(call.name);
+// Whole-array builtins declared by the parser. They are plain loops over i64 so the
+// vectorizer picks the vector width of the target (-mcpu/-mattr) and small calls
+// get inlined and specialized to a constant n.
+static Function *emitBuiltin(const string& name) {
+    Type *intTy = Builder->getInt64Ty(), *ptrTy = PointerType::get(*LLCTX, 0);
+    
+    vector<Type *> params;
+    if(name == "sum" || name == "min" || name == "max")
+        params = { ptrTy, intTy };
+    else if(name == "dot" || name == "copy")
+        params = { ptrTy, ptrTy, intTy };
+    else if(name == "count" || name == "fill")
+        params = { ptrTy, intTy, intTy };
+    else
+        return nullptr;
+    
+    Function *func = Function::Create(FunctionType::get(intTy, params, false), Function::InternalLinkage,
+                                      "gars." + name, TheModule.get());
+    func->setCallingConv(CallingConv::Fast);
+    func->addFnAttr(Attribute::NoUnwind);
+    
+    for(auto& Arg: func->args())
+        if(Arg.getType()->isPointerTy()) {
+            Arg.addAttr(Attribute::NoCapture);
+            if(!(name == "fill" || (name == "copy" && Arg.getArgNo() == 0)))
+                Arg.addAttr(Attribute::ReadOnly);
+        }
 
-    AddrVisitor *addr_vis = new AddrVisitor();
+    BasicBlock *prevbb = Builder->GetInsertBlock();
+    Builder->SetInsertPoint(BasicBlock::Create(*LLCTX, "entry", func));
+
+    Value *a = func->getArg(0), *n = func->getArg(params.size() - 1);
+    auto elem = [&](Value *arr, Value *i) {
+        return Builder->CreateLoad(intTy, Builder->CreateInBoundsGEP(intTy, arr, i));
+    };
+
+    Value *result;
+    if(name == "sum")
+        result = emitCountedLoop(n, Builder->getInt64(0), [&](Value *i, Value *acc) {
+            return Builder->CreateAdd(acc, elem(a, i));
+        });
+    else if(name == "min" || name == "max") {
+        // an empty range gives the identity of the reduction
+        bool isMin = (name == "min");
+        Value *init = Builder->getInt64(isMin? INT64_MAX : INT64_MIN);
+        
+        result = emitCountedLoop(n, init, [&](Value *i, Value *acc) {
+            return Builder->CreateBinaryIntrinsic(isMin? Intrinsic::smin : Intrinsic::smax, acc, elem(a, i));
+        });
+    }
+    else if(name == "dot")
+        result = emitCountedLoop(n, Builder->getInt64(0), [&](Value *i, Value *acc) {
+            return Builder->CreateAdd(acc, Builder->CreateMul(elem(a, i), elem(func->getArg(1), i)));
+        });
+    else if(name == "count")
+        result = emitCountedLoop(n, Builder->getInt64(0), [&](Value *i, Value *acc) {
+            Value *match = Builder->CreateICmpEQ(elem(a, i), func->getArg(1));
+            return Builder->CreateAdd(acc, Builder->CreateZExt(match, intTy));
+        });
+    else if(name == "fill") {
+        emitCountedLoop(n, Builder->getInt64(0), [&](Value *i, Value *acc) {
+            Builder->CreateStore(func->getArg(1), Builder->CreateInBoundsGEP(intTy, a, i));
+            return acc;
+        });
+        result = Builder->getInt64(0);
+    }
+    else {
+        // the ranges may overlap when both arguments are the same array
+        Value *bytes = Builder->CreateSelect(Builder->CreateICmpSGT(n, Builder->getInt64(0)),
+                                             Builder->CreateNSWMul(n, Builder->getInt64(8)), Builder->getInt64(0));
+        Builder->CreateMemMove(a, Align(8), func->getArg(1), Align(8), bytes);
+        result = Builder->getInt64(0);
+    }
 
-    size_t I = 0;
-    std::vector<Value *> args;
+    Builder->CreateRet(result);
+    Builder->SetInsertPoint(prevbb);
 
-    Value *argV;
+    return func;
+}
+
+// arrays are passed by address, everything else by value
+static bool emitArgs(CallExpr& call, Function *func, CodeVisitor& code_vis, std::vector<Value *>& args) {
+    AddrVisitor addr_vis;
+
+    size_t I = 0;
     for(auto& arg: call.args) {
+        Value *argV;
         if(func->getArg(I)->getType()->isPointerTy())
-            argV = arg->accept(*addr_vis);
+            argV = arg->accept(addr_vis);
         else
-            argV = arg->accept(*this);
+            argV = arg->accept(code_vis);
+
+        if(!argV)
+            return false;
         
         args.push_back(argV);
         
         ++I;
     }
+
+    return true;
+}
+
+Value *CodeVisitor::visit(CallExpr& call) {
+    Function *func = functions[call.sym->getSlot()];
+
+    // user functions are generated before any call to them, so an empty slot is a builtin
+    if(!func)
+        func = functions[call.sym->getSlot()] = emitBuiltin(call.name);
+
+    std::vector<Value *> args;
+    if(!emitArgs(call, func, *this, args))
+        return nullptr;
     
-    return Builder->CreateCall(func, args, "calltmp");
+    CallInst *CI = Builder->CreateCall(func, args, "calltmp");
+    CI->setCallingConv(func->getCallingConv());
+    return CI;
 }
 
 Value *CodeVisitor::visit(IntExpr& iexpr) {
@@ -373,79 +1330,75 @@ Value *CodeVisitor::visit(IntExpr& iexpr) {
 }
 
 Value *CodeVisitor::visit(ArrayExpr& array) {
-    Type *array_type = convert(array.type);
-    AllocaInst *arr_alloc = Builder->CreateAlloca(array_type, nullptr, "arrtemp");
-    
-    for(size_t i = 0, e = array.elements.size(); i < e; ++i) {
-        Value *gep = Builder->CreateInBoundsGEP(array_type, arr_alloc, {
-                ConstantInt::get(*LLCTX, APInt(64, 0)),
-                ConstantInt::get(*LLCTX, APInt(64, i))
-            });
-
-        Builder->CreateStore(array.elements[i]->accept(*this), gep);
-    }
-    
-    return Builder->CreateLoad(array_type, arr_alloc, "arrloadtemp");
+    return loadArray(array);
 }
 
 Value *CodeVisitor::visit(ParenExpr& pexpr) {
     return pexpr.expr->accept(*this);
 }
 
-Value *CodeVisitor::visit(IndexExpr& indexp) {
-    shared_ptr<LLSym> sym = find_symbol(indexp.name);
+// Address of an indexed element. Sized arrays live in their alloca or global,
+// unsized array parameters hold a pointer to their first element.
+static Value *indexAddr(IndexExpr& indexp, CodeVisitor& code_vis) {
+    Value *addr = symbolAddr(indexp.sym);
+    Type *arr_type = CodeVisitor::convert(indexp.sym->getType());
 
-    Type *gep_type = sym->addr->getAllocatedType();// convert(indexp.);
-    Value *gep_addr = sym->addr;
-    if(sym->type->isPointerTy())
-        gep_addr = Builder->CreateLoad(sym->type, sym->addr);
+    Type *gep_type = arr_type;
+    Value *gep_addr = addr;
+    std::vector<Value *> Ids;
+    
+    if(arr_type->isPointerTy()) {
+        gep_type = CodeVisitor::convert(indexp.sym->getType()->getSub());
+        gep_addr = Builder->CreateLoad(arr_type, addr);
+    }
+    else
+        Ids.push_back(ConstantInt::get(*LLCTX, APInt(64, 0)));
     
-    std::vector<Value *> Ids{ ConstantInt::get(*LLCTX, APInt(64, 0)) };
     for(size_t i = 0, e = indexp.Idxs.size(); i < e; ++i)
-        Ids.push_back(indexp.Idxs[i]->accept(*this));
+        Ids.push_back(indexp.Idxs[i]->accept(code_vis));
     
-    Value *gep = Builder->CreateInBoundsGEP(gep_type, gep_addr, Ids, "gep");
+    return Builder->CreateInBoundsGEP(gep_type, gep_addr, Ids, "gep");
+}
 
-    return Builder->CreateLoad(convert(indexp.type), gep);
+Value *CodeVisitor::visit(IndexExpr& indexp) {
+    return Builder->CreateLoad(convert(indexp.type), indexAddr(indexp, *this));
 }
 
 // AddrVisitor
 
 Value *AddrVisitor::visit(IDExpr& expr) {
-    shared_ptr<LLSym> sym = find_symbol(expr.name);
+    Value *addr = symbolAddr(expr.sym);
+    Type *addr_type = CodeVisitor::convert(expr.sym->getType());
     
-    if(expr.type->get() == ValueType::ARRAY)
-        return Builder->CreateGEP(sym->type, sym->addr, { ConstantInt::get(*LLCTX, APInt(64, 0)), ConstantInt::get(*LLCTX, APInt(64, 0)) });
+    if(expr.type->get() == ValueType::ARRAY) {
+        if(addr_type->isPointerTy())
+            return Builder->CreateLoad(addr_type, addr);
+        
+        return Builder->CreateGEP(addr_type, addr, { ConstantInt::get(*LLCTX, APInt(64, 0)), ConstantInt::get(*LLCTX, APInt(64, 0)) });
+    }
     
-    return sym->addr;
+    return addr;
 }
 
 Value *AddrVisitor::visit(IndexExpr& indexp) {
-    shared_ptr<LLSym> sym = find_symbol(indexp.name);
-
-    Type *gep_type = CodeVisitor::convert(indexp.type);// convert(indexp.);
-    Value *gep_addr = sym->addr;
-    
-    std::vector<Value *> Ids{ ConstantInt::get(*LLCTX, APInt(64, 0)) };
+    CodeVisitor code_vis;
     
-    CodeVisitor *code_vis = new CodeVisitor();
-    
-    for(size_t i = 0, e = indexp.Idxs.size(); i < e; ++i)
-        Ids.push_back(indexp.Idxs[i]->accept(*code_vis));
-
-    delete code_vis;
-    
-    return Builder->CreateGEP(sym->type, gep_addr, Ids, "gep");
+    return indexAddr(indexp, code_vis);
 }
 
-
-
 Value *AddrVisitor::visit(AssignExpr& assign) {
     Value *lhs = assign.LHS->accept(*this);
     if(!lhs)
         return nullptr;
 
     CodeVisitor *code_vis = new CodeVisitor();
+
+    if(assign.type == ValueType::ARRAY) {
+        bool ok = emitArrayInto(assign.RHS, lhs, *code_vis, assign.LHS->getType()->size() != 0);
+        delete code_vis;
+        
+        return (ok? lhs : nullptr);
+    }
     
     Value *rhs = assign.RHS->accept(*code_vis);
     
@@ -456,6 +1409,29 @@ Value *AddrVisitor::visit(AssignExpr& assign) {
     return lhs;
 }
 
+// a literal or arithmetic passed by address gets its own temporary, built in place
+static Value *arrayTemp(Expr& expr) {
+    AllocaInst *arr_alloc = CreateEntryBlockAlloca(CodeVisitor::convert(expr.getType()), "arrtemp");
+
+    CodeVisitor code_vis;
+    if(!emitArrayInto(&expr, arr_alloc, code_vis))
+        return nullptr;
+
+    return arr_alloc;
+}
+
+Value *AddrVisitor::visit(ArrayExpr& array) {
+    return arrayTemp(array);
+}
+
+Value *AddrVisitor::visit(AddExpr& add) {
+    return (add.type == ValueType::ARRAY? arrayTemp(add) : nullptr);
+}
+
+Value *AddrVisitor::visit(TermExpr& term) {
+    return (term.type == ValueType::ARRAY? arrayTemp(term) : nullptr);
+}
+
 
 Value *AddrVisitor::visit(ParenExpr& pexpr) {
     return pexpr.expr->accept(*this);
@@ -1,16 +1,136 @@
 #include "../include/visitor.hpp"
 #include "../include/codegen.hpp"
+#include "../include/fold.hpp"
+#include "../include/analysis.hpp"
 #include "../include/parser.hpp"
 #include "../include/lexer.hpp"
 #include "../include/table.hpp"
 #include "../include/type.hpp"
+#include "../runtime/runtime.hpp"
 
-#include <fstream>
-#include <sstream>
+#include "llvm/ExecutionEngine/Orc/AbsoluteSymbols.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/TargetParser/SubtargetFeature.h"
+#include "llvm/Transforms/Utils/Mem2Reg.h"
 
 using namespace llvm;
 using namespace llvm::sys;
 
+static cl::opt<std::string> InputFilename(cl::Positional, cl::desc("<input file>"), cl::Required);
+
+static cl::opt<std::string> OutputFilename("o", cl::desc("Output object file"),
+                                           cl::value_desc("filename"), cl::init("redtest.o"));
+
+static cl::opt<bool> RunJITMode("run", cl::desc("JIT-compile the program and execute main instead of writing an object file"));
+
+static cl::opt<char> OptLevel("O", cl::desc("Optimization level. [-O0, -O1, -O2, or -O3] (default = '-O0')"),
+                              cl::Prefix, cl::init('0'));
+
+static cl::opt<std::string> MCPU("mcpu", cl::desc("Target a specific cpu type (-mcpu=native for the host cpu)"),
+                                 cl::value_desc("cpu-name"), cl::init("generic"));
+
+static cl::list<std::string> MAttrs("mattr", cl::CommaSeparated, cl::desc("Target specific attributes"),
+                                    cl::value_desc("a1,+a2,-a3,..."));
+
+static std::string getCPUName() {
+    if(MCPU == "native")
+        return sys::getHostCPUName().str();
+    
+    return MCPU;
+}
+
+static std::string getFeatures() {
+    SubtargetFeatures Features;
+
+    if(MCPU == "native") {
+        StringMap<bool> HostFeatures;
+        if(sys::getHostCPUFeatures(HostFeatures))
+            for(auto& Feature: HostFeatures)
+                Features.AddFeature(Feature.first(), Feature.second);
+    }
+
+    // explicit -mattr goes last so it overrides the host defaults
+    for(auto& Attr: MAttrs)
+        Features.AddFeature(Attr);
+
+    return Features.getString();
+}
+
+// The vectorizer and instruction selection read the target from function attributes,
+// not from the TargetMachine, so every definition has to carry them.
+void setFunctionTargetAttrs(Module& TheModule, StringRef CPU, StringRef Features) {
+    for(Function& F: TheModule) {
+        if(F.isDeclaration())
+            continue;
+
+        F.addFnAttr("target-cpu", CPU);
+        if(!Features.empty())
+            F.addFnAttr("target-features", Features);
+    }
+}
+
+static OptimizationLevel getOptimizationLevel() {
+    switch(OptLevel) {
+    case '1': return OptimizationLevel::O1;
+    case '2': return OptimizationLevel::O2;
+    case '3': return OptimizationLevel::O3;
+    default: return OptimizationLevel::O0;
+    }
+}
+
+// Runs the new PassManager middle-end pipeline over the module.
+// -O0 keeps to the minimal always-inline pipeline plus mem2reg, so scalar locals still
+// become SSA registers while the output stays fast to build.
+void OptimizeModule(Module& TheModule, TargetMachine *TM, OptimizationLevel Level) {
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+
+    // Same vectorizer defaults clang uses for the given level
+    PipelineTuningOptions PTO;
+    PTO.LoopVectorization = Level.getSpeedupLevel() > 1;
+    PTO.SLPVectorization = Level.getSpeedupLevel() > 1;
+    
+    PassBuilder PB(TM, PTO);
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    ModulePassManager MPM;
+    if(Level == OptimizationLevel::O0) {
+        MPM = PB.buildO0DefaultPipeline(Level);
+        MPM.addPass(createModuleToFunctionPassAdaptor(PromotePass()));
+    }
+    else
+        MPM = PB.buildPerModuleDefaultPipeline(Level);
+    
+    MPM.run(TheModule, MAM);
+}
+
+// Shared by the object-file and JIT paths: binds the module to the target, verifies it and optimizes.
+int PrepareModule(Module& TheModule, TargetMachine *TM, StringRef CPU, StringRef Features) {
+    TheModule.setDataLayout(TM->createDataLayout());
+    setFunctionTargetAttrs(TheModule, CPU, Features);
+
+    if (verifyModule(TheModule, &errs())) {
+        errs() << "Module verification failed\n";
+        return 1;
+    }
+
+    OptimizeModule(TheModule, TM, getOptimizationLevel());
+
+    return 0;
+}
+
 int GenerateObjFile(std::string Filename, unique_ptr<Module> TheModule) {
     // * GENERATE OBJ FILE
     // Initialize the target registry etc.
@@ -34,14 +154,15 @@ int GenerateObjFile(std::string Filename, unique_ptr<Module> TheModule) {
         return 1;
     }
 
-    auto CPU = "generic";
-    auto Features = "";
+    auto CPU = getCPUName();
+    auto Features = getFeatures();
 
     TargetOptions opt;
     auto TheTargetMachine = Target->createTargetMachine(
-        TargetTriple, CPU, Features, opt, Reloc::PIC_);
+        TargetTriple, CPU, Features, opt, Reloc::PIC_, std::nullopt, *CodeGenOpt::parseLevel(OptLevel));
 
-    TheModule->setDataLayout(TheTargetMachine->createDataLayout());
+    if (PrepareModule(*TheModule, TheTargetMachine, CPU, Features))
+        return 1;
 
     std::error_code EC;
     raw_fd_ostream dest(Filename, EC, sys::fs::OF_None);
@@ -67,24 +188,109 @@ int GenerateObjFile(std::string Filename, unique_ptr<Module> TheModule) {
     return 0;
 }
 
+// runtime entry points of JIT-compiled programs, the compiler is linked with libgars_rt
+static const std::pair<const char *, void *> RuntimeSymbols[] = {
+    {"gars_alloc", (void *)&gars_alloc},
+    {"gars_free", (void *)&gars_free},
+    {"gars_parallel_for", (void *)&gars_parallel_for},
+    {"gars_print", (void *)&gars_print},
+    {"gars_echo", (void *)&gars_echo},
+};
+
+// Compiles the module in-process with ORC and calls its main.
+// The runtime is handed over by address, the rest of libc is resolved from the
+// compiler's own process.
+int RunJIT(unique_ptr<Module> TheModule, unique_ptr<LLVMContext> Ctx) {
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+
+    auto JTMB = orc::JITTargetMachineBuilder::detectHost();
+    if (!JTMB) {
+        errs() << toString(JTMB.takeError()) << "\n";
+        return 1;
+    }
+
+    // the JIT always runs on the host, -mattr can still switch features off
+    for (auto& Attr: MAttrs)
+        JTMB->getFeatures().AddFeature(Attr);
+    JTMB->setCodeGenOptLevel(*CodeGenOpt::parseLevel(OptLevel));
+
+    auto TheTargetMachine = JTMB->createTargetMachine();
+    if (!TheTargetMachine) {
+        errs() << toString(TheTargetMachine.takeError()) << "\n";
+        return 1;
+    }
+
+    TheModule->setTargetTriple(JTMB->getTargetTriple().str());
+    if (PrepareModule(*TheModule, TheTargetMachine->get(), JTMB->getCPU(), JTMB->getFeatures().getString()))
+        return 1;
+
+    auto JIT = orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(*JTMB)).create();
+    if (!JIT) {
+        errs() << toString(JIT.takeError()) << "\n";
+        return 1;
+    }
+
+    auto HostSymbols = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*JIT)->getDataLayout().getGlobalPrefix());
+    if (!HostSymbols) {
+        errs() << toString(HostSymbols.takeError()) << "\n";
+        return 1;
+    }
+    (*JIT)->getMainJITDylib().addGenerator(std::move(*HostSymbols));
+
+    orc::MangleAndInterner Mangle((*JIT)->getExecutionSession(), (*JIT)->getDataLayout());
+    orc::SymbolMap Runtime;
+    for (auto& [Name, Addr]: RuntimeSymbols)
+        Runtime[Mangle(Name)] = {orc::ExecutorAddr::fromPtr(Addr), JITSymbolFlags::Exported};
+
+    if (auto Err = (*JIT)->getMainJITDylib().define(orc::absoluteSymbols(std::move(Runtime)))) {
+        errs() << toString(std::move(Err)) << "\n";
+        return 1;
+    }
+
+    if (auto Err = (*JIT)->addIRModule(orc::ThreadSafeModule(std::move(TheModule), std::move(Ctx)))) {
+        errs() << toString(std::move(Err)) << "\n";
+        return 1;
+    }
+
+    auto MainAddr = (*JIT)->lookup("main");
+    if (!MainAddr) {
+        errs() << toString(MainAddr.takeError()) << "\n";
+        return 1;
+    }
+
+    auto *Main = MainAddr->toPtr<int64_t()>();
+    int Result = (int)Main();
+
+    // the program's output is still buffered in the runtime linked into the compiler
+    gars_flush();
+    
+    return Result;
+}
+
 
 int main(int argc, char *argv[]) {
-    std::ifstream file(argv[1]);
-    std::stringstream ss;
-    ss << file.rdbuf();
+    cl::ParseCommandLineOptions(argc, argv, "GARS compiler\n");
+
+    if(!CodeGenOpt::parseLevel(OptLevel)) {
+        errs() << "invalid optimization level: -O" << OptLevel << "\n";
+        return 1;
+    }
+    
+    // mapped read-only; the lexer and the tokens only borrow from this buffer
+    auto Source = MemoryBuffer::getFile(InputFilename, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if(!Source) {
+        errs() << "Could not open file " << InputFilename << ": " << Source.getError().message() << "\n";
+        return 1;
+    }
 
     shared_ptr<CompilerVisitor> comp_vis = make_unique<CompilerVisitor>();
     
-    unique_ptr<Lexer> lexer = make_unique<Lexer>(ss.str(), ss.str().size());
+    unique_ptr<Lexer> lexer = make_unique<Lexer>((*Source)->getBuffer());
 
     lexer->accept(comp_vis);
 
-    /*
-    for(auto token: comp_vis->tokens) {
-        std::cout << token.tok << "\n";
-    }
-    */
-    
     unique_ptr<Parser> parsec = make_unique<Parser>();
 
     parsec->accept(comp_vis);
@@ -92,11 +298,23 @@ int main(int argc, char *argv[]) {
     if(!comp_vis->AST)
         return 1;
 
+    unique_ptr<Folder> folder = make_unique<Folder>();
+
+    folder->accept(comp_vis);
+
+    unique_ptr<Analyzer> analyzer = make_unique<Analyzer>();
+
+    analyzer->accept(comp_vis);
+
     unique_ptr<Codegen> codegen = make_unique<Codegen>();
 
     codegen->accept(comp_vis);
 
-    GenerateObjFile("redtest.o", std::move(comp_vis->mod));
+    if(RunJITMode)
+        return RunJIT(std::move(comp_vis->mod), std::move(comp_vis->ctx));
+
+    if(GenerateObjFile(OutputFilename, std::move(comp_vis->mod)))
+        return 1;
     
     std::cout << "Compiling finished\n";
 }
@@ -0,0 +1,431 @@
+#include "../include/fold.hpp"
+
+#include <climits>
+
+// steps the interpreter may take over the whole program, and its call depth
+static constexpr int64_t FUEL = int64_t(1) << 26;
+static constexpr int MAX_DEPTH = 1000;
+
+// Integer operators as the generated code computes them. Overflow wraps here instead
+// of being undefined in the compiler itself; division by zero is left to the program.
+static bool evalOp(TOKEN::lexeme op, ll lhs, ll rhs, ll& result) {
+    using ull = unsigned long long;
+
+    switch(op) {
+    case TOKEN::PLUS: result = ll(ull(lhs) + ull(rhs)); return true;
+    case TOKEN::MINUS: result = ll(ull(lhs) - ull(rhs)); return true;
+    case TOKEN::MUL: result = ll(ull(lhs) * ull(rhs)); return true;
+    case TOKEN::DIV:
+        if(rhs == 0 || (lhs == LLONG_MIN && rhs == -1))
+            return false;
+        result = lhs / rhs;
+        return true;
+    case TOKEN::LS: result = (lhs < rhs); return true;
+    case TOKEN::GT: result = (lhs > rhs); return true;
+    case TOKEN::LSEQ: result = (lhs <= rhs); return true;
+    case TOKEN::GTEQ: result = (lhs >= rhs); return true;
+    case TOKEN::EQ: result = (lhs == rhs); return true;
+    case TOKEN::NOEQ: result = (lhs != rhs); return true;
+    default: return false;
+    }
+}
+
+// Tree-walking evaluator for calls with constant arguments. Anything it cannot
+// reproduce exactly at compile time (output, globals, arrays, parallel loops, calls to
+// builtins) or running out of fuel or depth fails the whole call, which then stays a
+// call; nothing it does is visible outside, so giving up halfway is always safe.
+// Results are left in `value`, `state` tells a return or a failure from normal flow.
+class Interpreter: public ASTVisitor {
+    const llvm::DenseMap<Symbol *, TrenStmt *>& bodies;
+    int64_t& fuel;
+    int depth = 0;
+
+    vector<ll> frame; // slots of the running function
+    ll value = 0;
+    enum { RUN, RETURN, FAIL } state = RUN;
+
+    bool step() {
+        if(state == FAIL)
+            return false;
+        if(--fuel < 0)
+            state = FAIL;
+
+        return state != FAIL;
+    }
+
+    Value *fail() {
+        state = FAIL;
+        return nullptr;
+    }
+
+    bool eval(Expr *expr, ll& result) {
+        expr->accept(*this);
+        result = value;
+        return state != FAIL;
+    }
+
+    Value *binary(TOKEN::lexeme op, Expr *lhs, Expr *rhs) {
+        ll l, r;
+        if(!step() || !eval(lhs, l) || !eval(rhs, r))
+            return nullptr;
+
+        if(!evalOp(op, l, r, value))
+            return fail();
+
+        return nullptr;
+    }
+public:
+    // runs func on args, false if the call has to be left to the program
+    bool call(TrenStmt& func, const vector<ll>& args, ll& result) {
+        if(depth >= MAX_DEPTH)
+            return false;
+
+        vector<ll> outer = std::move(frame);
+        frame.assign(func.nslots, 0);
+        std::copy(args.begin(), args.end(), frame.begin());
+
+        ++depth;
+        func.func_body->accept(*this);
+        --depth;
+
+        frame = std::move(outer);
+
+        if(state == FAIL)
+            return false;
+
+        // falling off the end of a function returns zero
+        result = (state == RETURN? value : 0);
+        state = RUN;
+
+        return true;
+    }
+
+    Value *visit(WarStmt& war) {
+        ll init = 0;
+        if(!step() || war.type != ValueType::INT || (war.value && !eval(war.value, init)))
+            return fail();
+
+        frame[war.sym->getSlot()] = init;
+        return nullptr;
+    }
+
+    // a nested definition does not run anything
+    Function *visit(TrenStmt&) { return nullptr; }
+
+    Value *visit(RetStmt& ret) {
+        if(step() && eval(ret.expr, value))
+            state = RETURN;
+
+        return nullptr;
+    }
+
+    Value *visit(IfStmt& ifstmt) {
+        ll cond;
+        if(step() && eval(ifstmt.Cond, cond) && cond)
+            ifstmt.Body->accept(*this);
+
+        return nullptr;
+    }
+
+    Value *visit(AliveStmt& alive) {
+        ll cond;
+        while(step() && eval(alive.Cond, cond) && cond && state == RUN)
+            alive.Body->accept(*this);
+
+        return nullptr;
+    }
+
+    Value *visit(ForStmt& forstmt) {
+        ll start, end;
+        if(!step() || !eval(forstmt.Start, start) || !eval(forstmt.End, end))
+            return nullptr;
+
+        for(ll i = start; i < end && step() && state == RUN; ++i) {
+            frame[forstmt.sym->getSlot()] = i;
+            forstmt.Body->accept(*this);
+        }
+
+        return nullptr;
+    }
+
+    Value *visit(FightStmt&) { return fail(); }
+
+    Value *visit(HighExpr& hexpr) {
+        ll ignored;
+        if(step())
+            eval(hexpr.expr, ignored);
+
+        return nullptr;
+    }
+
+    Value *visit(ParenStmts& parens) {
+        for(Stmt *stmt: parens.stmts) {
+            if(!step() || state != RUN)
+                break;
+
+            stmt->accept(*this);
+        }
+
+        return nullptr;
+    }
+
+    Value *visit(AssignExpr& assign) {
+        auto *target = dynamic_cast<IDExpr *>(assign.LHS);
+        if(!target || target->sym->isGlobal() || target->type != ValueType::INT)
+            return fail();
+
+        if(step() && eval(assign.RHS, value))
+            frame[target->sym->getSlot()] = value;
+
+        return nullptr;
+    }
+
+    Value *visit(BoolExpr& boolexpr) { return binary(boolexpr.OP, boolexpr.LHS, boolexpr.RHS); }
+    Value *visit(AddExpr& add) { return binary(add.OP, add.LHS, add.RHS); }
+    Value *visit(TermExpr& term) { return binary(term.OP, term.LHS, term.RHS); }
+
+    // globals can change while the program runs, const ones are literals by now
+    Value *visit(IDExpr& idexpr) {
+        if(!step() || idexpr.sym->isGlobal() || idexpr.type != ValueType::INT)
+            return fail();
+
+        value = frame[idexpr.sym->getSlot()];
+        return nullptr;
+    }
+
+    Value *visit(CallExpr& callexpr) {
+        auto callee = bodies.find(callexpr.sym);
+        if(!step() || callee == bodies.end())
+            return fail();
+
+        vector<ll> args(callexpr.args.size());
+        for(size_t i = 0; i < args.size(); ++i)
+            if(!eval(callexpr.args[i], args[i]))
+                return nullptr;
+
+        if(!call(*callee->second, args, value))
+            return fail();
+
+        return nullptr;
+    }
+
+    Value *visit(IntExpr& intexpr) {
+        if(step())
+            value = intexpr.value;
+
+        return nullptr;
+    }
+
+    Value *visit(ArrayExpr&) { return fail(); }
+
+    Value *visit(ParenExpr& paren) {
+        if(step())
+            eval(paren.expr, value);
+
+        return nullptr;
+    }
+
+    Value *visit(IndexExpr&) { return fail(); }
+
+    Value *visit(Input&) { return fail(); }
+
+    Interpreter(const llvm::DenseMap<Symbol *, TrenStmt *>& bodies, int64_t& fuel)
+        : bodies(bodies), fuel(fuel) {}
+};
+
+
+FoldVisitor::FoldVisitor(Arena& arena, TypeContext& types)
+    : arena(arena), types(types), fuel(FUEL) {}
+
+Expr *FoldVisitor::fold(Expr *expr) {
+    folded = expr;
+    expr->accept(*this);
+    return folded;
+}
+
+Expr *FoldVisitor::literal(ll value) {
+    return arena.make<IntExpr>(value, types.getInt());
+}
+
+Value *FoldVisitor::visit(WarStmt& war) {
+    if(war.size)
+        war.size = fold(war.size);
+
+    if(!war.value)
+        return nullptr;
+
+    war.value = fold(war.value);
+
+    if(auto *init = dynamic_cast<IntExpr *>(war.value))
+        if(war.sym->isConstant() && war.type == ValueType::INT)
+            constants[war.sym] = init->value;
+
+    return nullptr;
+}
+
+Function *FoldVisitor::visit(TrenStmt& tren) {
+    tren.func_body->accept(*this);
+
+    // calls fold once the whole body is known, so a function is never evaluated from
+    // inside its own definition
+    bool ints = (tren.retType == ValueType::INT);
+    for(auto& arg: tren.args)
+        ints = ints && (arg.second == ValueType::INT);
+
+    if(ints)
+        bodies[tren.sym] = &tren;
+
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(RetStmt& ret) {
+    ret.expr = fold(ret.expr);
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(IfStmt& ifstmt) {
+    ifstmt.Cond = fold(ifstmt.Cond);
+    ifstmt.Body->accept(*this);
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(AliveStmt& alive) {
+    alive.Cond = fold(alive.Cond);
+    alive.Body->accept(*this);
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(ForStmt& forstmt) {
+    forstmt.Start = fold(forstmt.Start);
+    forstmt.End = fold(forstmt.End);
+    forstmt.Body->accept(*this);
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(FightStmt& fight) {
+    fight.Start = fold(fight.Start);
+    fight.End = fold(fight.End);
+    fight.Body->accept(*this);
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(HighExpr& hexpr) {
+    hexpr.expr = fold(hexpr.expr);
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(ParenStmts& parens) {
+    for(Stmt *stmt: parens.stmts)
+        stmt->accept(*this);
+
+    return nullptr;
+}
+
+// the target is never a known constant, only the indices in it can fold
+Value *FoldVisitor::visit(AssignExpr& assign) {
+    assign.LHS = fold(assign.LHS);
+    assign.RHS = fold(assign.RHS);
+    folded = &assign;
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(BoolExpr& boolexpr) {
+    boolexpr.LHS = fold(boolexpr.LHS);
+    boolexpr.RHS = fold(boolexpr.RHS);
+    folded = &boolexpr;
+
+    auto *lhs = dynamic_cast<IntExpr *>(boolexpr.LHS), *rhs = dynamic_cast<IntExpr *>(boolexpr.RHS);
+    ll result;
+    if(lhs && rhs && evalOp(boolexpr.OP, lhs->value, rhs->value, result))
+        folded = literal(result);
+
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(AddExpr& add) {
+    add.LHS = fold(add.LHS);
+    add.RHS = fold(add.RHS);
+    folded = &add;
+
+    auto *lhs = dynamic_cast<IntExpr *>(add.LHS), *rhs = dynamic_cast<IntExpr *>(add.RHS);
+    ll result;
+    if(lhs && rhs && evalOp(add.OP, lhs->value, rhs->value, result))
+        folded = literal(result);
+
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(TermExpr& term) {
+    term.LHS = fold(term.LHS);
+    term.RHS = fold(term.RHS);
+    folded = &term;
+
+    auto *lhs = dynamic_cast<IntExpr *>(term.LHS), *rhs = dynamic_cast<IntExpr *>(term.RHS);
+    ll result;
+    if(lhs && rhs && evalOp(term.OP, lhs->value, rhs->value, result))
+        folded = literal(result);
+
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(IDExpr& idexpr) {
+    auto known = constants.find(idexpr.sym);
+    folded = (known != constants.end()? literal(known->second) : &idexpr);
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(CallExpr& callexpr) {
+    vector<ll> args;
+    for(Expr *&arg: callexpr.args) {
+        arg = fold(arg);
+        if(auto *constant = dynamic_cast<IntExpr *>(arg))
+            args.push_back(constant->value);
+    }
+
+    folded = &callexpr;
+
+    auto callee = bodies.find(callexpr.sym);
+    if(callee == bodies.end() || args.size() != callexpr.args.size() || fuel <= 0)
+        return nullptr;
+
+    Interpreter interp(bodies, fuel);
+    ll result;
+    if(interp.call(*callee->second, args, result))
+        folded = literal(result);
+
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(IntExpr& intexpr) {
+    folded = &intexpr;
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(ArrayExpr& array) {
+    for(Expr *&elem: array.elements)
+        elem = fold(elem);
+
+    folded = &array;
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(ParenExpr& paren) {
+    paren.expr = fold(paren.expr);
+    folded = (dynamic_cast<IntExpr *>(paren.expr)? paren.expr : &paren);
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(IndexExpr& index) {
+    for(Expr *&idx: index.Idxs)
+        idx = fold(idx);
+
+    folded = &index;
+    return nullptr;
+}
+
+Value *FoldVisitor::visit(Input& inp) {
+    for(Stmt *stmt: inp.stmts)
+        stmt->accept(*this);
+
+    return nullptr;
+}
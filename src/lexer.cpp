@@ -1,79 +1,190 @@
 #include "../include/lexer.hpp"
 
-using std::cerr, std::stoll, std::unordered_map;
-
-static unordered_map<string, TOKEN::lexeme> tokTable {
-   // keywords
-    {"if", TOKEN::IF}, {"alive", TOKEN::ALIVE}, {"by", TOKEN::BY},
-    {"var", TOKEN::WAR}, {"you", TOKEN::YOU}, {"fn", TOKEN::TREN}, 
-    {"REDGAR", TOKEN::REDGAR}, {"fightclub", TOKEN::FIGHTCLUB},
-    {"want", TOKEN::WANT}, {"this", TOKEN::THIS}, {"do", TOKEN::DO},
-    {"return", TOKEN::RETURN}, 
-    
-    // liters
-    {"true", TOKEN::TRUE}, {"false", TOKEN::FALSE},
-
-    // types
-    {"array", TOKEN::ARRAYTYPE}, {"int", TOKEN::INTTYPE},
-
-    // ops
-    {"{", TOKEN::LBRA}, {"}", TOKEN::RBRA},
-    {"(", TOKEN::LBAR}, {")", TOKEN::RBAR},
-    {"[", TOKEN::LBRACE}, {"]", TOKEN::RBRACE},
-    {":", TOKEN::COL}, {";", TOKEN::SEMICOL}, {",", TOKEN::COMMA}, {"|", TOKEN::ST},
-    {"+", TOKEN::PLUS}, {"-", TOKEN::MINUS}, {"/", TOKEN::DIV}, {"*", TOKEN::MUL},
-    {"!", TOKEN::NOT},  {"=", TOKEN::ASSIGN}, {"<", TOKEN::LS}, {">", TOKEN::GT},
-    {"!=", TOKEN::NOEQ},  {"==", TOKEN::EQ}, {"<=", TOKEN::LSEQ}, {">=", TOKEN::GTEQ}
+#include <climits>
+#include <cstring>
+
+using std::cerr, std::string_view;
+
+namespace {
+
+enum CharClass : unsigned char {
+    CC_OTHER, CC_SPACE, CC_NEWLINE, CC_ALPHA, CC_DIGIT, CC_QUOTE, CC_PUNCT
+};
+
+// one lookup per char instead of the isalpha/isdigit/isspace/ispunct chain
+struct CharTable {
+    CharClass cls[256] = {};
+
+    constexpr CharTable() {
+        for(int c = '!'; c <= '~'; ++c)
+            cls[c] = CC_PUNCT;
+        for(int c = 'a'; c <= 'z'; ++c)
+            cls[c] = CC_ALPHA;
+        for(int c = 'A'; c <= 'Z'; ++c)
+            cls[c] = CC_ALPHA;
+        for(int c = '0'; c <= '9'; ++c)
+            cls[c] = CC_DIGIT;
+
+        cls[(unsigned char)' '] = cls[(unsigned char)'\t'] = CC_SPACE;
+        cls[(unsigned char)'\r'] = cls[(unsigned char)'\v'] = cls[(unsigned char)'\f'] = CC_SPACE;
+        cls[(unsigned char)'\n'] = CC_NEWLINE;
+        cls[(unsigned char)'"'] = CC_QUOTE;
+    }
+
+    CharClass operator[](char c) const { return cls[(unsigned char)c]; }
 };
 
+constexpr CharTable charTable;
+
+// keywords are told apart by length first, so every word costs at most a couple of compares
+TOKEN::lexeme keyword(string_view word) {
+    switch(word.size()) {
+    case 2:
+        if(word == "if") return TOKEN::IF;
+        if(word == "by") return TOKEN::BY;
+        if(word == "fn") return TOKEN::TREN;
+        if(word == "do") return TOKEN::DO;
+        break;
+    case 3:
+        if(word == "var") return TOKEN::WAR;
+        if(word == "for") return TOKEN::FOR;
+        if(word == "int") return TOKEN::INTTYPE;
+        if(word == "you") return TOKEN::YOU;
+        break;
+    case 4:
+        if(word == "true") return TOKEN::TRUE;
+        if(word == "want") return TOKEN::WANT;
+        if(word == "this") return TOKEN::THIS;
+        break;
+    case 5:
+        if(word == "alive") return TOKEN::ALIVE;
+        if(word == "array") return TOKEN::ARRAYTYPE;
+        if(word == "false") return TOKEN::FALSE;
+        if(word == "const") return TOKEN::CONST;
+        break;
+    case 6:
+        if(word == "return") return TOKEN::RETURN;
+        if(word == "REDGAR") return TOKEN::REDGAR;
+        if(word == "export") return TOKEN::EXPORT;
+        break;
+    case 9:
+        if(word == "fightclub") return TOKEN::FIGHTCLUB;
+        break;
+    }
+
+    return TOKEN::IDENTIFIER;
+}
+
+TOKEN::lexeme punct(char c) {
+    switch(c) {
+    case '{': return TOKEN::LBRA;
+    case '}': return TOKEN::RBRA;
+    case '(': return TOKEN::LBAR;
+    case ')': return TOKEN::RBAR;
+    case '[': return TOKEN::LBRACE;
+    case ']': return TOKEN::RBRACE;
+    case ':': return TOKEN::COL;
+    case ';': return TOKEN::SEMICOL;
+    case ',': return TOKEN::COMMA;
+    case '|': return TOKEN::ST;
+    case '+': return TOKEN::PLUS;
+    case '-': return TOKEN::MINUS;
+    case '/': return TOKEN::DIV;
+    case '*': return TOKEN::MUL;
+    case '!': return TOKEN::NOT;
+    case '=': return TOKEN::ASSIGN;
+    case '<': return TOKEN::LS;
+    case '>': return TOKEN::GT;
+    default: return TOKEN::UNDEFINED;
+    }
+}
+
+// "op=" forms of the single char ops
+TOKEN::lexeme punctEq(TOKEN::lexeme tok) {
+    switch(tok) {
+    case TOKEN::ASSIGN: return TOKEN::EQ;
+    case TOKEN::NOT: return TOKEN::NOEQ;
+    case TOKEN::LS: return TOKEN::LSEQ;
+    case TOKEN::GT: return TOKEN::GTEQ;
+    default: return TOKEN::UNDEFINED;
+    }
+}
+
+}
+
 TOKEN Lexer::getNextToken() {
-    string word;
+    const char *src = text.data();
+
+    for(; i < tsize; ++i) {
+        CharClass cls = charTable[src[i]];
+        if(cls == CC_NEWLINE)
+            ++line;
+        else if(cls != CC_SPACE)
+            break;
+    }
 
     if(i == tsize)
         return TOKEN(TOKEN::EOFILE, line);
-    else if(isalpha(text[i])) {
-        for(; isalnum(text[i]) && i < tsize; ++i)
-            word += text[i];
+
+    size_t start = i;
     
-        if(tokTable.count(word))
-            return TOKEN(tokTable[word], line);
+    switch(charTable[src[i]]) {
+    case CC_ALPHA: {
+        for(++i; i < tsize && (charTable[src[i]] == CC_ALPHA || charTable[src[i]] == CC_DIGIT); ++i);
+
+        string_view word(src + start, i - start);
+
+        TOKEN::lexeme tok = keyword(word);
+        if(tok != TOKEN::IDENTIFIER)
+            return TOKEN(tok, line);
 
         return TOKEN(TOKEN::IDENTIFIER, word, line);
     }
-    else if(isdigit(text[i])) {
-        for(; isdigit(text[i]); ++i) {
-            word += text[i];
+    case CC_DIGIT: {
+        ll value = 0;
+        bool overflow = false;
+        for(; i < tsize && charTable[src[i]] == CC_DIGIT; ++i) {
+            int digit = src[i] - '0';
+            if(value > (LLONG_MAX - digit) / 10)
+                overflow = true;
+            else
+                value = value * 10 + digit;
         }
 
-        return TOKEN(TOKEN::INTEGER, stoll(word), line);
+        if(overflow)
+            return LexError("integer literal too large");
+
+        return TOKEN(TOKEN::INTEGER, value, line);
     }
-    else if(text[i] == '"') {
-        for(++i; text[i] != '"' && i < tsize; ++i)
-            word += text[i];
-    
-        if(i == tsize && text[i] != '"')
+    case CC_QUOTE: {
+        ++start;
+        const char *end = (const char *)memchr(src + start, '"', tsize - start);
+        if(!end) {
+            i = tsize;
             return LexError("excepted '" + string{'"'} + "'");
-        else if(i != tsize) ++i;
-    
-        return TOKEN(TOKEN::STRING, word, line);
-    }
-    else if(isspace(text[i])) {
-        if(text[i++] == '\n') ++line;
-        return getNextToken();
+        }
+
+        i = end - src + 1;
+
+        return TOKEN(TOKEN::STRING, string_view(src + start, end - src - start), line);
     }
-    else if(ispunct(text[i])) {
-        word += text[i++];
-        if(!tokTable.count(word))
+    case CC_PUNCT: {
+        TOKEN::lexeme tok = punct(src[i++]);
+        if(tok == TOKEN::UNDEFINED)
             return LexError("unknown punct");
-        else if((int)tokTable[word] < (int)TOKEN::ASSIGN || (int)tokTable[word] > (int)TOKEN::LSEQ)
-            return TOKEN(tokTable[word], line);
-    
-        if(i < tsize && text[i] == '=')
-            word += text[i++];
 
-        return TOKEN(tokTable[word], line);
+        TOKEN::lexeme eqTok = punctEq(tok);
+        if(eqTok != TOKEN::UNDEFINED && i < tsize && src[i] == '=') {
+            ++i;
+            return TOKEN(eqTok, line);
+        }
+
+        return TOKEN(tok, line);
+    }
+    default: break;
     }
 
+    ++i;
     return LexError("unknown char");
 }
 
@@ -1,59 +1,111 @@
 #include "../include/parser.hpp"
 
 TOKEN Parser::nextToken() {
-    return CurrTok = lex_tokens[++i];
+    if(la_size == 0)
+        return CurrTok = lexer->getNextToken();
+
+    CurrTok = lookahead[la_head];
+    la_head = (la_head + 1) % LOOKAHEAD;
+    --la_size;
+
+    return CurrTok;
+}
+
+// n-th token after CurrTok, lexed on demand
+TOKEN Parser::peekToken(size_t n) {
+    if(n == 0 || n > LOOKAHEAD)
+        return TOKEN(TOKEN::UNDEFINED, CurrTok.line);
+
+    for(; la_size < n; ++la_size)
+        lookahead[(la_head + la_size) % LOOKAHEAD] = lexer->getNextToken();
+
+    return lookahead[(la_head + n - 1) % LOOKAHEAD];
+}
+
+ASTSym *Parser::declareVar(const string& name, ValueType *type) {
+    ASTSym *sym = arena->make<ASTSym>(name, type, next_slot++, curr_owner);
+    table->add_symbol(sym);
+    return sym;
+}
+
+ASTSym *Parser::declareGlobal(const string& name, ValueType *type) {
+    ASTSym *sym = arena->make<ASTSym>(name, type, next_global++, curr_owner);
+    sym->global = true;
+    table->add_symbol(sym);
+    return sym;
+}
+
+ASTSym *Parser::declareFunc(const string& name, ValueType *type, vector<pair<string, ValueType *>> args) {
+    ASTSym *sym = arena->make<ASTSym>(name, type, std::move(args), next_func++);
+    table->add_symbol(sym);
+    return sym;
 }
 
 void Parser::LogError(const string& msg) {
     std::cerr << "SyntaxError: " << msg << ". Line: " << CurrTok.line << ".\n";
 }
 
-unique_ptr<Stmt> Parser::LogStmtError(const string& msg) {
+Stmt *Parser::LogStmtError(const string& msg) {
     LogError(msg);
     return nullptr;
 }
 
-unique_ptr<Expr> Parser::LogExprError(const string& msg) {
+Expr *Parser::LogExprError(const string& msg) {
     LogError(msg);
     return nullptr;
 }
 
-shared_ptr<ValueType> Parser::LogTypeError(const string& msg) {
+ValueType *Parser::LogTypeError(const string& msg) {
     LogError(msg);
     return nullptr;
 }
 
-unique_ptr<Input> Parser::ParseInput() {
-    CurrTok = lex_tokens[i];
+Input *Parser::ParseInput() {
+    nextToken();
 
     table->enter_scope();
 
-    vector<pair<string, shared_ptr<ValueType>>> print_args{ {"value", make_shared<IntType>() } };
+    // print and echo are provided by the runtime, in this order
+    declareFunc("print", types->getInt(), {{"value", types->getInt()}});
+    declareFunc("echo", types->getInt(), {{"value", types->getInt()}});
+
+    // whole-array builtins, n is the element count; codegen emits them on first use
+    ValueType *intTy = types->getInt(), *arrTy = types->getArray(intTy, 0);
     
-    table->add_symbol(make_shared<ASTSym>("print", make_shared<IntType>(), std::move(print_args)));
+    declareFunc("sum", intTy, {{"a", arrTy}, {"n", intTy}})->written = 0;
+    declareFunc("min", intTy, {{"a", arrTy}, {"n", intTy}})->written = 0;
+    declareFunc("max", intTy, {{"a", arrTy}, {"n", intTy}})->written = 0;
+    declareFunc("dot", intTy, {{"a", arrTy}, {"b", arrTy}, {"n", intTy}})->written = 0;
+    declareFunc("count", intTy, {{"a", arrTy}, {"value", intTy}, {"n", intTy}})->written = 0;
+    declareFunc("fill", intTy, {{"a", arrTy}, {"value", intTy}, {"n", intTy}})->written = 1;
+    declareFunc("copy", intTy, {{"dst", arrTy}, {"src", arrTy}, {"n", intTy}})->written = 1;
     
-    vector<unique_ptr<Stmt>> stmts;
+    vector<Stmt *> stmts;
 
     while(CurrTok != TOKEN::EOFILE) {
-        unique_ptr<Stmt> stmt = ParseStatement();
+        Stmt *stmt = ParseStatement();
         if(!stmt)
             return nullptr;
         
-        stmts.push_back(std::move(stmt));
+        stmts.push_back(stmt);
     }
 
     table->exit_scope();
     
-    return make_unique<Input>(std::move(stmts));
+    return arena->make<Input>(std::move(stmts), next_slot, next_func, next_global);
 }
 
 
-unique_ptr<Stmt> Parser::ParseStatement() {
+Stmt *Parser::ParseStatement() {
     switch(CurrTok.tok) {
         case TOKEN::IF: return ParseIfStmt();
-        case TOKEN::WAR: return ParseWarStmt();
-        case TOKEN::TREN: return ParseTrenStmt();
+        case TOKEN::WAR:
+        case TOKEN::CONST: return ParseWarStmt();
+        case TOKEN::TREN:
+        case TOKEN::EXPORT: return ParseTrenStmt();
         case TOKEN::ALIVE: return ParseAliveStmt();
+        case TOKEN::FOR: return ParseForStmt();
+        case TOKEN::FIGHTCLUB: return ParseFightStmt();
         case TOKEN::RETURN: return ParseRetStmt();
         case TOKEN::LBRA: return ParseParenStmts();
         case TOKEN::EOFILE: return LogStmtError("missing statement");
@@ -63,31 +115,35 @@ unique_ptr<Stmt> Parser::ParseStatement() {
     return nullptr;
 }
 
-unique_ptr<Stmt> Parser::ParseIfStmt() {
+Stmt *Parser::ParseIfStmt() {
     nextToken(); // eat if
     if(CurrTok != TOKEN::LBRACE)
         return LogStmtError("excepted '['");
 
     nextToken(); // eat [
-    unique_ptr<Expr> cond = ParseExpression();
+    Expr *cond = ParseExpression();
     if(!cond)
         return nullptr;
 
     if(cond->getType() != ValueType::INT)
         return LogStmtError("condition must be a integer");
+
+    Hints hints;
+    if(CurrTok == TOKEN::ST && !ParseHints(hints, false))
+        return nullptr;
     
     if(CurrTok != TOKEN::RBRACE)
         return LogStmtError("excepted ']'");
 
     nextToken();
-    unique_ptr<Stmt> body = ParseStatement();
+    Stmt *body = ParseBody();
     if(!body)
         return nullptr;
     
-    return make_unique<IfStmt>(std::move(cond), std::move(body));
+    return arena->make<IfStmt>(cond, body, hints);
 }
 
-unique_ptr<Stmt> Parser::ParseAliveStmt() {
+Stmt *Parser::ParseAliveStmt() {
     nextToken(); // eat alive
 
     if(CurrTok != TOKEN::BY)
@@ -98,69 +154,272 @@ unique_ptr<Stmt> Parser::ParseAliveStmt() {
         return LogStmtError("excepted '['");
 
     nextToken();
-    unique_ptr<Expr> cond = ParseExpression();
+    Expr *cond = ParseExpression();
     if(!cond)
         return nullptr;
 
     if(cond->getType() != ValueType::INT)
         return LogStmtError("condition must be a integer");
+
+    Hints hints;
+    if(CurrTok == TOKEN::ST && !ParseHints(hints, true))
+        return nullptr;
     
     if(CurrTok != TOKEN::RBRACE)
         return LogStmtError("excepted ']'");
 
     nextToken();
-    unique_ptr<Stmt> body = ParseStatement();
+    Stmt *body = ParseBody();
     if(!body)
         return nullptr;
 
-    return make_unique<AliveStmt>(std::move(cond), std::move(body));
+    return arena->make<AliveStmt>(cond, body, hints);
 }
 
-unique_ptr<Stmt> Parser::ParseWarStmt() {
+// [i = start, end | clauses] header shared by for and fightclub
+bool Parser::ParseRange(string& varName, Expr *&start, Expr *&end, Hints& hints, vector<Reduction> *reductions) {
+    if(CurrTok != TOKEN::LBRACE) {
+        LogError("excepted '['");
+        return false;
+    }
+
+    nextToken();
+    if(CurrTok != TOKEN::IDENTIFIER) {
+        LogError("excepted identifier");
+        return false;
+    }
+
+    varName = string(CurrTok.word);
+
+    nextToken();
+    if(CurrTok != TOKEN::ASSIGN) {
+        LogError("excepted '='");
+        return false;
+    }
+
     nextToken();
+    start = ParseExpression();
+    if(!start)
+        return false;
+
+    if(CurrTok != TOKEN::COMMA) {
+        LogError("excepted ','");
+        return false;
+    }
+
+    nextToken();
+    end = ParseExpression();
+    if(!end)
+        return false;
+
+    if(start->getType() != ValueType::INT || end->getType() != ValueType::INT) {
+        LogError("range bounds must be integers");
+        return false;
+    }
+
+    if(CurrTok == TOKEN::ST && !ParseHints(hints, true, reductions))
+        return false;
+    
+    if(CurrTok != TOKEN::RBRACE) {
+        LogError("excepted ']'");
+        return false;
+    }
+
+    nextToken();
+    
+    return true;
+}
+
+Stmt *Parser::ParseForStmt() {
+    nextToken(); // eat for
+
+    string varName;
+    Expr *start, *end;
+    Hints hints;
+    if(!ParseRange(varName, start, end, hints, nullptr))
+        return nullptr;
+
+    // the induction variable is read-only, so the trip count is known on entry
+    table->enter_scope(table->scope_name());
+    ASTSym *sym = declareVar(varName, types->getInt());
+    sym->constant = true;
+    
+    Stmt *body = ParseStatement();
+    if(!body)
+        return nullptr;
+
+    table->exit_scope();
+
+    return arena->make<ForStmt>(varName, sym, start, end, body, hints);
+}
+
+Stmt *Parser::ParseFightStmt() {
+    nextToken(); // eat fightclub
+
+    // the body is outlined into one function, a nested parallel loop would need a second
+    if(in_fightclub)
+        return LogStmtError("fightclub cannot be nested");
+
+    string varName;
+    Expr *start, *end;
+    Hints hints;
+    vector<Reduction> reductions;
+    if(!ParseRange(varName, start, end, hints, &reductions))
+        return nullptr;
+
+    table->enter_scope(table->scope_name());
+    ASTSym *sym = declareVar(varName, types->getInt());
+    sym->constant = true;
+
+    in_fightclub = true;
+    Stmt *body = ParseStatement();
+    in_fightclub = false;
+    if(!body)
+        return nullptr;
+
+    table->exit_scope();
+
+    return arena->make<FightStmt>(varName, sym, start, end, body, hints, std::move(reductions));
+}
+
+// The body of an if or a loop is a block of its own even without braces,
+// so whatever it declares is gone once it has run.
+Stmt *Parser::ParseBody() {
+    table->enter_scope(table->scope_name());
+    
+    Stmt *body = ParseStatement();
+    if(!body)
+        return nullptr;
+
+    table->exit_scope();
+
+    return body;
+}
+
+// hint names are not reserved words, they only mean something after '|'
+bool Parser::ParseHints(Hints& hints, bool loop, vector<Reduction> *reductions) {
+    do {
+        nextToken(); // eat | or ,
+
+        if(CurrTok != TOKEN::IDENTIFIER) {
+            LogError("excepted hint");
+            return false;
+        }
+
+        string hint(CurrTok.word);
+        nextToken();
+
+        if(loop && (hint == "unroll" || hint == "vectorize")) {
+            if(CurrTok != TOKEN::INTEGER || CurrTok.ival <= 0) {
+                LogError("excepted positive count after '" + hint + "'");
+                return false;
+            }
+
+            (hint == "unroll"? hints.unroll : hints.vectorize) = CurrTok.ival;
+            nextToken();
+        }
+        else if(!loop && (hint == "likely" || hint == "unlikely"))
+            hints.likely = (hint == "likely"? 1 : -1);
+        else if(reductions && (hint == "sum" || hint == "min" || hint == "max")) {
+            if(CurrTok != TOKEN::IDENTIFIER) {
+                LogError("excepted variable after '" + hint + "'");
+                return false;
+            }
+
+            Symbol *var = table->find_symbol(CurrTok.word);
+            if(!var || var->isFunction() || var->getType() != ValueType::INT || var->isConstant()
+               || (!var->isGlobal() && var->getOwner() != curr_owner)) {
+                LogError("cannot reduce into '" + string(CurrTok.word) + "'");
+                return false;
+            }
+            
+            if(var->isGlobal())
+                static_cast<ASTSym *>(var)->shared = true;
+
+            Reduction::Kind kind = (hint == "sum"? Reduction::SUM : hint == "min"? Reduction::MIN : Reduction::MAX);
+            reductions->push_back({kind, var});
+            nextToken();
+        }
+        else {
+            LogError("unknown hint '" + hint + "'");
+            return false;
+        }
+    } while(CurrTok == TOKEN::COMMA);
+
+    return true;
+}
+
+Stmt *Parser::ParseWarStmt() {
+    bool constant = (CurrTok == TOKEN::CONST);
+    
+    nextToken(); // eat var or const
 
     if(CurrTok != TOKEN::IDENTIFIER)
         return LogStmtError("excepted identifier");
 
-    string warName = CurrTok.word;
+    string warName(CurrTok.word);
 
     nextToken();
     if(CurrTok != TOKEN::COL)
         return LogStmtError("excepted ';'");
 
     nextToken();
-    shared_ptr<ValueType> warType = ParseType();
+    Expr *warSize = nullptr;
+    ValueType *warType = ParseType(false, &warSize);
     if(!warType)
         return nullptr;
-    
-    if(CurrTok != TOKEN::ASSIGN)
-        return LogStmtError("excepted '='");
 
-    nextToken();
-    unique_ptr<Expr> warValue = ParseExpression();
-    if(!warValue)
-        return nullptr;
+    // heap arrays start zeroed, there is no literal of a runtime size to give them
+    Expr *warValue = nullptr;
+    if(!warSize) {
+        if(CurrTok != TOKEN::ASSIGN)
+            return LogStmtError("excepted '='");
 
-    if(warType != warValue->getType())
-        return LogStmtError("invalid war value");
+        nextToken();
+        warValue = ParseExpression();
+        if(!warValue)
+            return nullptr;
+
+        if(!sameType(warType, warValue->getType()))
+            return LogStmtError("invalid war value");
+
+        if(warType == ValueType::ARRAY && !warValue->getType()->size())
+            return LogStmtError("cannot copy an array of unknown size");
+    }
     
     if(CurrTok != TOKEN::SEMICOL)
         return LogStmtError("excepted ';'");
 
     nextToken();
 
-    table->add_symbol(make_shared<ASTSym>(warName, warType));
+    // variables of the top-level scope outlive every function, so they live in the module
+    bool global = (curr_owner == -1 && table->depth() == 1);
     
-    return make_unique<WarStmt>(warName, std::move(warValue), warType);
+    ASTSym *sym = (global? declareGlobal(warName, warType) : declareVar(warName, warType));
+    sym->constant = constant;
+    sym->heap = (warSize != nullptr);
+    
+    return arena->make<WarStmt>(warName, sym, warValue, warType, warSize);
 }
 
-unique_ptr<Stmt> Parser::ParseTrenStmt() {
+Stmt *Parser::ParseTrenStmt() {
+    bool exported = (CurrTok == TOKEN::EXPORT);
+    if(exported) {
+        // a nested function belongs to its parent, only top-level ones get a symbol
+        if(curr_owner != -1)
+            return LogStmtError("only top-level functions can be exported");
+
+        nextToken(); // eat export
+        if(CurrTok != TOKEN::TREN)
+            return LogStmtError("excepted 'fn' after 'export'");
+    }
+
     nextToken(); // eat tren
 
     if(CurrTok != TOKEN::IDENTIFIER)
         return LogStmtError("excepted identifier");
 
-    string funcName = CurrTok.word;
+    string funcName(CurrTok.word);
 
     nextToken(); // eat identifier
     if(CurrTok != TOKEN::COL)
@@ -168,32 +427,27 @@ unique_ptr<Stmt> Parser::ParseTrenStmt() {
 
     nextToken();
     
-    shared_ptr<ValueType> funcType = ParseType(true);
+    ValueType *funcType = ParseType(true);
     if(!funcType)
         return nullptr;
     
     if(CurrTok != TOKEN::LBRACE)
         return LogStmtError("excepted '['");
 
-    shared_ptr<Scope> scope = table->get_scope();
-    table->enter_scope(funcName);
-    
-    vector<pair<string, shared_ptr<ValueType>>> args;
+    vector<pair<string, ValueType *>> args;
     
     nextToken(); // eat [
     while(CurrTok != TOKEN::RBRACE) {
-        shared_ptr<ValueType> arg_type = ParseType(true);
+        ValueType *arg_type = ParseType(true);
         if(!arg_type)
             return nullptr;
 
         if(CurrTok != TOKEN::IDENTIFIER)
             return LogStmtError("excepted identifier");
 
-        string arg_name = CurrTok.word;
+        string arg_name(CurrTok.word);
 
         args.push_back({arg_name, arg_type});
-
-        table->add_symbol(make_shared<ASTSym>(arg_name, arg_type));
         
         nextToken();
         if(CurrTok != TOKEN::RBRACE && CurrTok != TOKEN::COMMA)
@@ -206,40 +460,58 @@ unique_ptr<Stmt> Parser::ParseTrenStmt() {
     }
     nextToken(); // eat ]
 
-    scope->set_symbol(make_shared<ASTSym>(funcName, funcType, args));
+    // the function is visible in the enclosing scope, its arguments only inside it
+    ASTSym *sym = declareFunc(funcName, funcType, args);
+
+    int outer_slot = next_slot, outer_owner = curr_owner;
+    bool outer_fightclub = in_fightclub;
+    next_slot = 0;
+    curr_owner = sym->slot;
+    in_fightclub = false;
     
-    unique_ptr<Stmt> func_body = ParseStatement();
+    table->enter_scope(funcName);
+    for(auto& [arg_name, arg_type]: args)
+        declareVar(arg_name, arg_type);
+    
+    Stmt *func_body = ParseStatement();
     if(!func_body)
         return nullptr;
 
     table->exit_scope();
+
+    int nslots = next_slot;
+    next_slot = outer_slot;
+    curr_owner = outer_owner;
+    in_fightclub = outer_fightclub;
     
-    return make_unique<TrenStmt>(funcName, std::move(func_body), funcType, std::move(args));
+    auto *tren = arena->make<TrenStmt>(funcName, sym, func_body, funcType, std::move(args), nslots);
+    tren->exported = exported;
+    return tren;
 }
 
-unique_ptr<Stmt> Parser::ParseParenStmts() {
+Stmt *Parser::ParseParenStmts() {
     nextToken(); // eat {
     
-    vector<unique_ptr<Stmt>> stmts;
+    vector<Stmt *> stmts;
 
-    table->enter_scope(table->get_scope()->getName());
+    table->enter_scope(table->scope_name());
     while(CurrTok != TOKEN::RBRA) {
-        unique_ptr<Stmt> stmt = ParseStatement();
+        Stmt *stmt = ParseStatement();
         if(!stmt)
             return nullptr;
 
-        stmts.push_back(std::move(stmt));
+        stmts.push_back(stmt);
     }
     table->exit_scope();
     
     nextToken();
     
-    return make_unique<ParenStmts>(std::move(stmts));
+    return arena->make<ParenStmts>(std::move(stmts));
 }
 
 
-unique_ptr<Stmt> Parser::ParseHighExpr() {
-    unique_ptr<Expr> expr = ParseExpression();
+Stmt *Parser::ParseHighExpr() {
+    Expr *expr = ParseExpression();
     if(!expr)
         return nullptr;
     
@@ -248,31 +520,48 @@ unique_ptr<Stmt> Parser::ParseHighExpr() {
 
     nextToken();
     
-    return make_unique<HighExpr>(std::move(expr));
+    return arena->make<HighExpr>(expr);
 }
 
-unique_ptr<Stmt> Parser::ParseRetStmt() {
+Stmt *Parser::ParseRetStmt() {
     nextToken(); // eat return
 
-    unique_ptr<Expr> retVal = ParseExpression();
+    Expr *retVal = ParseExpression();
     if(!retVal)
         return nullptr;
 
-    shared_ptr<Scope> scope = table->get_scope();
-    shared_ptr<Symbol> sym = table->find_symbol(scope->getName());
+    Symbol *sym = table->find_symbol(table->scope_name());
+    if(!sym)
+        return LogStmtError("return outside of function");
+
+    if(in_fightclub)
+        return LogStmtError("return inside fightclub");
+
+    Expr *retArr = retVal;
+    while(auto *paren = dynamic_cast<ParenExpr *>(retArr))
+        retArr = paren->expr;
 
-    if(sym->getType() != retVal->getType())
+    auto *id = dynamic_cast<IDExpr *>(retArr);
+    if(id && id->sym->isHeap())
+        return LogStmtError("heap array '" + id->name + "' is freed on return");
+
+    if(!sameType(sym->getType(), retVal->getType()))
         return LogStmtError("invalid return type");
+
+    if(sym->getType()->size() && retVal->getType() == ValueType::ARRAY && !retVal->getType()->size())
+        return LogStmtError("cannot copy an array of unknown size");
     
     if(CurrTok != TOKEN::SEMICOL)
         return LogStmtError("excepted ';'");
 
     nextToken();
     
-    return make_unique<RetStmt>(std::move(retVal));
+    return arena->make<RetStmt>(retVal);
 }
 
-shared_ptr<ValueType> Parser::ParseType(bool fT) {
+// heap_size, when given, lets the outer dimension be a runtime expression:
+// the array is then heap-allocated and typed as unsized, like an array parameter.
+ValueType *Parser::ParseType(bool fT, Expr **heap_size) {
     switch(CurrTok.tok) {
     case TOKEN::ARRAYTYPE: {
         nextToken(); // eat array
@@ -280,20 +569,37 @@ shared_ptr<ValueType> Parser::ParseType(bool fT) {
             return LogTypeError("excepted '<'");
 
         nextToken(); // eat <
-        shared_ptr<ValueType> subType = ParseType();
+        ValueType *subType = ParseType();
         
         if(CurrTok != TOKEN::GT)
             return LogTypeError("excepted '>'");
         
         nextToken();
         if(CurrTok != TOKEN::LBRACE && fT)
-            return make_shared<ArrayType>(subType, 0);
+            return types->getArray(subType, 0);
         else if(CurrTok != TOKEN::LBRACE)
             return LogTypeError("excepted '['");
         
         nextToken();
-        if(CurrTok != TOKEN::INTEGER)
-            return LogTypeError("excepted array size");
+        if(CurrTok != TOKEN::INTEGER || peekToken() != TOKEN::RBRACE) {
+            if(!heap_size)
+                return LogTypeError("excepted array size");
+
+            Expr *count = ParseExpression();
+            if(!count)
+                return nullptr;
+
+            if(count->getType() != ValueType::INT)
+                return LogTypeError("array size must be integer");
+
+            if(CurrTok != TOKEN::RBRACE)
+                return LogTypeError("excepted ']'");
+
+            nextToken();
+            
+            *heap_size = count;
+            return types->getArray(subType, 0);
+        }
 
         int arr_size = CurrTok.ival;
         
@@ -303,118 +609,135 @@ shared_ptr<ValueType> Parser::ParseType(bool fT) {
 
         nextToken();
 
-        return make_shared<ArrayType>(subType, arr_size);
+        return types->getArray(subType, arr_size);
     }
     case TOKEN::INTTYPE:
         nextToken();
-        return make_shared<IntType>();
+        return types->getInt();
     default: return LogTypeError("excepted type");
     }
     
     return nullptr;
 }
 
-unique_ptr<Expr> Parser::ParseExpression() {
-    unique_ptr<Expr> lhs = ParseBoolExpr();
+Expr *Parser::ParseExpression() {
+    Expr *lhs = ParseBoolExpr();
     if(!lhs)
         return nullptr;
 
     if(CurrTok != TOKEN::ASSIGN)
-        return std::move(lhs);
+        return lhs;
     
     nextToken(); // eat =
-    unique_ptr<Expr> value = ParseExpression();
+    Expr *value = ParseExpression();
     if(!value)
         return nullptr;
 
-    if(lhs->getType() != value->getType())
+    if(!sameType(lhs->getType(), value->getType()))
         return LogExprError("invalid types");
+
+    // heap arrays and unsized parameters have no size to check a copy against
+    if(value->getType() == ValueType::ARRAY && (!value->getType()->size() || !lhs->getType()->size()))
+        return LogExprError("cannot copy an array of unknown size");
+
+    Expr *dest = lhs;
+    while(auto *paren = dynamic_cast<ParenExpr *>(dest))
+        dest = paren->expr;
+
+    Symbol *target = nullptr;
+    if(auto *id = dynamic_cast<IDExpr *>(dest))
+        target = id->sym;
+    else if(auto *index = dynamic_cast<IndexExpr *>(dest))
+        target = index->sym;
+    
+    if(target && target->isConstant())
+        return LogExprError("cannot assign to '" + target->getName() + "'");
     
-    return make_unique<AssignExpr>(std::move(lhs), std::move(value), lhs->getType());
+    return arena->make<AssignExpr>(lhs, value, lhs->getType());
 }
 
-unique_ptr<Expr> Parser::ParseBoolExpr() {
-    unique_ptr<Expr> lhs = ParseAddExpr();
+Expr *Parser::ParseBoolExpr() {
+    Expr *lhs = ParseAddExpr();
     if(!lhs)
         return nullptr;
 
     while(true) {
         if((int)CurrTok.tok < (int)TOKEN::LS || (int)CurrTok.tok > (int)TOKEN::LSEQ)
-            return std::move(lhs);
+            return lhs;
 
         TOKEN::lexeme Op = CurrTok.tok;
 
         nextToken(); // eat Op
 
-        unique_ptr<Expr> rhs = ParseAddExpr();
+        Expr *rhs = ParseAddExpr();
         if(!rhs)
             return nullptr;
 
-        if(lhs->getType() != rhs->getType() ||
+        if(!sameType(lhs->getType(), rhs->getType()) ||
            !matchType("bool",maxType(lhs->getType(), rhs->getType())))
             return LogExprError("invalid types");
         
-        lhs = make_unique<BoolExpr>(Op, std::move(lhs), std::move(rhs), lhs->getType());   
+        lhs = arena->make<BoolExpr>(Op, lhs, rhs, lhs->getType());   
     }
 
     return LogExprError("whata fuck this error undefined");
 }
 
-unique_ptr<Expr> Parser::ParseAddExpr() {
-    unique_ptr<Expr> lhs = ParseTermExpr();
+Expr *Parser::ParseAddExpr() {
+    Expr *lhs = ParseTermExpr();
     if(!lhs)
         return nullptr;
 
     while(true) {
         if((int)CurrTok.tok < (int)TOKEN::PLUS || (int)CurrTok.tok > (int)TOKEN::MINUS)
-            return std::move(lhs);
+            return lhs;
 
         TOKEN::lexeme Op = CurrTok.tok;
 
         nextToken(); // eat Op
 
-        unique_ptr<Expr> rhs = ParseTermExpr();
+        Expr *rhs = ParseTermExpr();
         if(!rhs)
             return nullptr;
 
-        if(lhs->getType() != rhs->getType() ||
-           !matchType("add", maxType(lhs->getType(), rhs->getType())))
+        ValueType *type = maxType(lhs->getType(), rhs->getType());
+        if(!matchType("add", type))
             return LogExprError("invalid types");
         
-        lhs = make_unique<AddExpr>(Op, std::move(lhs), std::move(rhs), lhs->getType());   
+        lhs = arena->make<AddExpr>(Op, lhs, rhs, type);   
     }
 
     return LogExprError("whata fuck this error undefined");
 }
 
-unique_ptr<Expr> Parser::ParseTermExpr() {
-    unique_ptr<Expr> lhs = ParseFactor();
+Expr *Parser::ParseTermExpr() {
+    Expr *lhs = ParseFactor();
     if(!lhs)
         return nullptr;
 
     while(true) {
         if((int)CurrTok.tok < (int)TOKEN::DIV || (int)CurrTok.tok > (int)TOKEN::MUL)
-            return std::move(lhs);
+            return lhs;
 
         TOKEN::lexeme Op = CurrTok.tok;
 
         nextToken(); // eat Op
 
-        unique_ptr<Expr> rhs = ParseFactor();
+        Expr *rhs = ParseFactor();
         if(!rhs)
             return nullptr;
 
-        if(lhs->getType() != rhs->getType() ||
-           !matchType("term", maxType(lhs->getType(), rhs->getType())))
+        ValueType *type = maxType(lhs->getType(), rhs->getType());
+        if(!matchType("term", type))
             return LogExprError("invalid types");
         
-        lhs = make_unique<TermExpr>(Op, std::move(lhs), std::move(rhs), lhs->getType());   
+        lhs = arena->make<TermExpr>(Op, lhs, rhs, type);   
     }
 
     return LogExprError("whata fuck this error undefined");
 }
 
-unique_ptr<Expr> Parser::ParseFactor() {
+Expr *Parser::ParseFactor() {
     switch(CurrTok.tok) {
     case TOKEN::INTEGER:
         return ParseInteger();
@@ -434,34 +757,37 @@ unique_ptr<Expr> Parser::ParseFactor() {
     return LogExprError("whata fuck this error undefined");
 }
 
-unique_ptr<Expr> Parser::ParseInteger() {
+Expr *Parser::ParseInteger() {
     ll value = CurrTok.ival;
     nextToken();
-    return make_unique<IntExpr>(value);
+    return arena->make<IntExpr>(value, types->getInt());
 }
 
-unique_ptr<Expr> Parser::ParseTrueFalse() {
+Expr *Parser::ParseTrueFalse() {
     ll value = (CurrTok == TOKEN::TRUE? 1:0);
     nextToken();
-    return make_unique<IntExpr>(value);
+    return arena->make<IntExpr>(value, types->getInt());
 }
 
-unique_ptr<Expr> Parser::ParseArray() {
+Expr *Parser::ParseArray() {
     nextToken();
-    shared_ptr<ValueType> subType = make_shared<NoneType>();
+    ValueType *subType = types->getNone();
 
-    vector<unique_ptr<Expr>> elems;
+    vector<Expr *> elems;
     while(CurrTok != TOKEN::RBRACE) {
-        unique_ptr<Expr> elem = ParseExpression();
+        Expr *elem = ParseExpression();
         if(!elem)
             return nullptr;
         
         if(subType == ValueType::NONETYPE)
             subType = elem->getType();
-        else if(elem->getType() != subType)
+        else if(!sameType(elem->getType(), subType))
             return LogExprError("invalid array element type");
+
+        if(elem->getType() == ValueType::ARRAY && !elem->getType()->size())
+            return LogExprError("cannot copy an array of unknown size");
         
-        elems.push_back(std::move(elem));
+        elems.push_back(elem);
         
         if(CurrTok != TOKEN::RBRACE && CurrTok != TOKEN::COMMA)
             return LogExprError("excepted ]");
@@ -474,42 +800,56 @@ unique_ptr<Expr> Parser::ParseArray() {
 
     nextToken();
 
-    return make_unique<ArrayExpr>(std::move(elems), make_shared<ArrayType>(subType, elems.size()));
+    ValueType *arrType = types->getArray(subType, elems.size());
+
+    return arena->make<ArrayExpr>(std::move(elems), arrType);
 }
 
-unique_ptr<Expr> Parser::ParseIdentifier() {
-    string IDName = CurrTok.word;
+Expr *Parser::ParseIdentifier() {
+    string IDName(CurrTok.word);
 
     nextToken();
     
-    shared_ptr<Symbol> id_sym = table->find_symbol(IDName);
+    Symbol *id_sym = table->find_symbol(IDName);
     if(!id_sym)
         return LogExprError("unknown identifier");
 
+    if(!id_sym->isFunction() && id_sym->getOwner() != curr_owner) {
+        if(!id_sym->isGlobal())
+            return LogExprError("'" + IDName + "' is a local of another function");
+
+        // every symbol comes from declareVar/declareGlobal
+        static_cast<ASTSym *>(id_sym)->shared = true;
+    }
+
+    // a fightclub body runs in a function of its own, so it needs the real global too
+    if(in_fightclub && id_sym->isGlobal())
+        static_cast<ASTSym *>(id_sym)->shared = true;
+
     if(CurrTok != TOKEN::LBAR && CurrTok != TOKEN::LBRACE) {
-        if(id_sym->getArgs().size() > 0)
+        if(id_sym->isFunction())
             return LogExprError("invalid call");
 
-        return make_unique<IDExpr>(IDName, id_sym->getType());     
+        return arena->make<IDExpr>(IDName, id_sym, id_sym->getType());     
     }
     else if(CurrTok == TOKEN::LBRACE) {
         nextToken();
 
-        shared_ptr<ValueType> Vtype = id_sym->getType();
+        ValueType *Vtype = id_sym->getType();
 
         if(Vtype != ValueType::ARRAY)
             return LogExprError("identifier type must be array");
         
-        vector<unique_ptr<Expr>> Idxs;
+        vector<Expr *> Idxs;
         while(CurrTok != TOKEN::RBRACE) {
-            unique_ptr<Expr> index = ParseExpression();
+            Expr *index = ParseExpression();
             if(!index)
                 return nullptr;
 
             if(index->getType() != ValueType::INT)
                 return LogExprError("index must be integer");
             
-            Idxs.push_back(std::move(index));
+            Idxs.push_back(index);
             
             if(CurrTok != TOKEN::COMMA && CurrTok != TOKEN::RBRACE)
                 return LogExprError("excepted ']'");
@@ -522,25 +862,44 @@ unique_ptr<Expr> Parser::ParseIdentifier() {
         }
         nextToken();
         
-        return make_unique<IndexExpr>(IDName, std::move(Idxs), Vtype);
+        return arena->make<IndexExpr>(IDName, id_sym, std::move(Idxs), Vtype);
     }    
     
+    if(!id_sym->isFunction())
+        return LogExprError("'" + IDName + "' is not a function");
+    
     size_t I = 0;
-    vector<unique_ptr<Expr>> args;
+    vector<Expr *> args;
     
     nextToken(); // eat (
     while(CurrTok != TOKEN::RBAR) {
         if(I == id_sym->getArgs().size())
             return LogExprError("invalid number of args");
         
-        unique_ptr<Expr> arg = ParseExpression();
+        Expr *arg = ParseExpression();
         if(!arg)
             return nullptr;
 
-        if(arg->getType() != id_sym->getArgs()[I++].second)
+        ValueType *param = id_sym->getArgs()[I].second;
+        if(!sameType(arg->getType(), param))
             return LogExprError("invalid types");
+
+        // a sized parameter gets a copy of the array, only an unsized one takes any array
+        if(param->size() && arg->getType() == ValueType::ARRAY && !arg->getType()->size())
+            return LogExprError("cannot pass an array of unknown size to '" + IDName + "'");
+
+        // arrays are passed by address, a constant one may sit in read-only memory
+        Expr *byAddr = arg;
+        while(auto *paren = dynamic_cast<ParenExpr *>(byAddr))
+            byAddr = paren->expr;
+        
+        auto *id = dynamic_cast<IDExpr *>(byAddr);
+        if(id && id->sym->isConstant() && arg->getType() == ValueType::ARRAY && id_sym->writesArg(I))
+            return LogExprError("constant array '" + id->name + "' cannot be passed to '" + IDName + "'");
+
+        ++I;
         
-        args.push_back(std::move(arg));
+        args.push_back(arg);
 
         if(CurrTok != TOKEN::RBAR && CurrTok != TOKEN::COMMA)
             return LogExprError("excepted ')'");
@@ -550,14 +909,17 @@ unique_ptr<Expr> Parser::ParseIdentifier() {
                 return LogExprError("excepted argument expression after comma");
         }
     }
+
+    if(I != id_sym->getArgs().size())
+        return LogExprError("invalid number of args");
     
     nextToken(); // eat ]
-    return make_unique<CallExpr>(IDName, std::move(args), id_sym->getType());
+    return arena->make<CallExpr>(IDName, id_sym, std::move(args), id_sym->getType());
 }
 
-unique_ptr<Expr> Parser::ParseParenExpr() {
+Expr *Parser::ParseParenExpr() {
     nextToken(); // eat (
-    unique_ptr<Expr> expr = ParseExpression();
+    Expr *expr = ParseExpression();
     if(!expr)
         return nullptr;
 
@@ -566,5 +928,5 @@ unique_ptr<Expr> Parser::ParseParenExpr() {
     
     nextToken();
     
-    return make_unique<ParenExpr>(std::move(expr));
+    return arena->make<ParenExpr>(expr);
 }
@@ -6,56 +6,71 @@ unordered_map<string, unordered_set<ValueType::type>> typeTable{
             ValueType::INT
         }},
     {"add", {
-            ValueType::INT
+            ValueType::INT, ValueType::ARRAY
         }},
     {"term", {
-            ValueType::INT
+            ValueType::INT, ValueType::ARRAY
         }}
 };
 
-shared_ptr<ValueType> maxType(shared_ptr<ValueType> t1, shared_ptr<ValueType> t2) {
+ValueType *TypeContext::getArray(ValueType *sub, int size) {
+    ArrayType *&arrTy = arrayTys[{sub, size}];
+    if(!arrTy)
+        arrTy = arena.make<ArrayType>(sub, size);
+
+    return arrTy;
+}
+
+// Integers in a sized (possibly nested) int array, 0 for anything that is not one.
+long long elementCount(ValueType *type) {
+    if(type->get() == ValueType::INT)
+        return 1;
+    if(type->get() != ValueType::ARRAY)
+        return 0;
+    
+    return type->size() * elementCount(type->getSub());
+}
+
+// Arithmetic on arrays is element-wise: both arrays have the same shape,
+// or one side is an integer applied to every element.
+ValueType *maxType(ValueType *t1, ValueType *t2) {
     if(t1->get() == ValueType::INT &&
        t2->get() == ValueType::INT)
         return t1;
     else if(t1->get() == ValueType::ARRAY &&
             t2->get() == ValueType::ARRAY)
-        return t1;
+        return (t1 == t2 && elementCount(t1)? t1 : nullptr);
+    else if(t1->get() == ValueType::ARRAY && t2->get() == ValueType::INT)
+        return (elementCount(t1)? t1 : nullptr);
+    else if(t1->get() == ValueType::INT && t2->get() == ValueType::ARRAY)
+        return (elementCount(t2)? t2 : nullptr);
 
     return nullptr;
 }
 
-bool matchType(const string& name, shared_ptr<ValueType> type) {
-    return typeTable[name].count(type->get());
+bool matchType(const string& name, ValueType *type) {
+    return type && typeTable[name].count(type->get());
 }
 
 
-bool operator==(shared_ptr<ValueType> t1, ValueType::type t2)
+bool operator==(ValueType *t1, ValueType::type t2)
 {
     return t1->get() == t2;
 }
 
 
-bool operator!=(shared_ptr<ValueType> t1, ValueType::type t2)
+bool operator!=(ValueType *t1, ValueType::type t2)
 {
     return !(t1 == t2);
 }
 
-bool operator==(shared_ptr<ValueType> t1, shared_ptr<ValueType> t2)
+bool sameType(ValueType *t1, ValueType *t2)
 {
-    if(t1->get() == ValueType::INT &&
-       t2->get() == ValueType::INT)
+    if(t1 == t2)
         return true;
-    else if(t1->get() == ValueType::ARRAY &&
-            t2->get() == ValueType::ARRAY) {
-        
-        return ((t1->size() == t2->size() || !t1->size() || !t2->size())
-                && t1->getSub() == t2->getSub());
-    }
-    
-    return false;
-}
 
-bool operator!=(shared_ptr<ValueType> t1, shared_ptr<ValueType> t2)
-{
-    return !(t1 == t2);
+    // an unsized array parameter accepts arrays of any size
+    return (t1->get() == ValueType::ARRAY && t2->get() == ValueType::ARRAY
+            && (!t1->size() || !t2->size())
+            && t1->getSub() == t2->getSub());
 }
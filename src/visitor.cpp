@@ -1,5 +1,7 @@
 #include "../include/visitor.hpp"
 #include "../include/codegen.hpp"
+#include "../include/fold.hpp"
+#include "../include/analysis.hpp"
 #include "../include/parser.hpp"
 #include "../include/lexer.hpp"
 #include "../include/token.hpp"
@@ -18,21 +20,30 @@
 */
 
 
+// tokens are not collected here, the parser pulls them from the lexer while parsing
 void CompilerVisitor::visit(Lexer& lex) {
-    TOKEN CurrTok = lex.getNextToken();
-    
-    while(!(CurrTok == TOKEN::EOFILE)) {
-        tokens.push_back(CurrTok);
-        CurrTok = lex.getNextToken();
-    }
-    tokens.push_back(CurrTok);
+    lexer = &lex;
 }
 
 void CompilerVisitor::visit(Parser& parser) {
-    parser.setTokens(std::move(tokens));
+    parser.setLexer(lexer);
+    parser.setArena(&arena);
+    parser.setTypes(&types);
     AST = parser.ParseInput();
 }
 
+void CompilerVisitor::visit(Folder&) {
+    FoldVisitor visitor(arena, types);
+
+    AST->accept(visitor);
+}
+
+void CompilerVisitor::visit(Analyzer&) {
+    EffectVisitor visitor;
+
+    AST->accept(visitor);
+}
+
 void CompilerVisitor::visit(Codegen& code) {
    CodeVisitor *visitor = new CodeVisitor();
 
@@ -41,6 +52,7 @@ void CompilerVisitor::visit(Codegen& code) {
    AST->accept(*visitor);
         
    mod = std::move(visitor->getModule());
+   ctx = std::move(visitor->getContext());
 
    mod->print(llvm::errs(), nullptr);
 
@@ -0,0 +1,25 @@
+# Runs one program with the JIT and compares what it prints with the expected output.
+# cmake -DCOMPILER=<compiler> -DOPT=<0..3> -DPROGRAM=<file.gars> -DEXPECTED=<file.out> -P run.cmake
+
+execute_process(COMMAND ${COMPILER} -O${OPT} -run ${PROGRAM}
+                OUTPUT_VARIABLE output
+                ERROR_VARIABLE errors
+                RESULT_VARIABLE result
+                TIMEOUT 60)
+
+file(READ ${EXPECTED} expected)
+
+# the compiler dumps the whole module to stderr, the diagnostics are at its end
+if(NOT result EQUAL 0)
+    string(LENGTH "${errors}" length)
+    if(length GREATER 2000)
+        math(EXPR start "${length} - 2000")
+        string(SUBSTRING "${errors}" ${start} -1 errors)
+    endif()
+
+    message(FATAL_ERROR "${PROGRAM} -O${OPT} exited with ${result}\n${errors}")
+endif()
+
+if(NOT output STREQUAL expected)
+    message(FATAL_ERROR "${PROGRAM} -O${OPT} printed\n${output}\nexpected\n${expected}")
+endif()